@@ -8,18 +8,46 @@
 #pragma once
 #include "PixelArtImage.h"
 #include "imgui.h"
+#include <algorithm>
+#include <atomic>
 #include <string>
 
 class Algorithm {
 public:
     virtual ~Algorithm() = default;
-    explicit Algorithm(PixelArtImage& canvasToSet) : canvas(canvasToSet) {}
+    explicit Algorithm(PixelArtImage& canvasToSet) : canvas(&canvasToSet) {}
 
     [[nodiscard]] virtual std::string name() const = 0;
 
     [[nodiscard]] PixelArtImage& getPixelArtImage() const {
-        return this->canvas;
+        return *this->canvas;
     }
+
+    /**
+     * Rebinds the algorithm to another image, e.g. a snapshot owned by a background job.
+     * @param canvasToSet the image subsequent calls operate on
+     */
+    void setPixelArtImage(PixelArtImage& canvasToSet) {
+        this->canvas = &canvasToSet;
+    }
+
+    /**
+     * Describes every setting that influences run(), including random seeds, e.g. for cache keys.
+     * Runs with equal names and parameters on equal images must give equal results.
+     * @return "key=value" pairs separated by ';', or an empty string if there are no settings
+     */
+    [[nodiscard]] virtual std::string parameters() const {
+        return {};
+    }
+
+    /**
+     * Accounts the scratch held between runs, e.g. debug layers; the image is accounted separately.
+     * @return the bytes held per structure
+     */
+    [[nodiscard]] virtual MemoryBreakdown getMemoryUsage() const {
+        return {};
+    }
+
     virtual void run() = 0;
     virtual void renderUI() {
         ImGui::Text("No options available.");
@@ -31,8 +59,49 @@ public:
         getPixelArtImage().clearProcessedPixels();
         getPixelArtImage().clearDebugPixels();
     }
+
+    /**
+     * Progress of the current run, in [0, 1]. Safe to read from any thread.
+     */
+    [[nodiscard]] float getProgress() const {
+        return progress.load();
+    }
+
+    /**
+     * Asks a running run() to stop at its next cancellation point. Safe to call from any thread.
+     */
+    void requestCancel() {
+        cancelRequested = true;
+    }
+
+    /**
+     * Clears the progress and cancellation state before a new run.
+     */
+    void clearRunState() {
+        progress = 0.0f;
+        cancelRequested = false;
+    }
+
+protected:
+    /**
+     * Reports the progress of the current run.
+     * @param fraction completed fraction, clamped to [0, 1]
+     */
+    void reportProgress(float fraction) {
+        progress = std::clamp(fraction, 0.0f, 1.0f);
+    }
+
+    /**
+     * Cancellation point for long-running algorithms; run() should return early once this is true.
+     */
+    [[nodiscard]] bool isCancelled() const {
+        return cancelRequested.load();
+    }
+
 private:
-    PixelArtImage& canvas;
+    PixelArtImage* canvas;
+    std::atomic<float> progress{0.0f};
+    std::atomic<bool> cancelRequested{false};
 };
 
 
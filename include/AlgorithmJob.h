@@ -0,0 +1,75 @@
+#ifndef ALGORITHMJOB_H
+#define ALGORITHMJOB_H
+
+#pragma once
+#include "Algorithm.h"
+#include "PixelArtImage.h"
+#include <atomic>
+#include <functional>
+#include <thread>
+
+/**
+ * @class AlgorithmJob
+ * Runs an Algorithm on a worker thread against a snapshot of a PixelArtImage.
+ *
+ * The displayed image is never touched while the job runs; the finished snapshot
+ * is swapped into it in one step by collect(), from the thread that owns the image.
+ */
+class AlgorithmJob {
+public:
+    /**
+     * Snapshots the target image, rebinds the algorithm to the snapshot and starts the run.
+     * @param algorithm the algorithm to run; must outlive the job
+     * @param target the displayed image; must outlive the job
+     * @param onFinished called from the worker thread once the run is over, e.g. to wake an idle event loop
+     */
+    AlgorithmJob(Algorithm &algorithm, PixelArtImage &target, std::function<void()> onFinished = {});
+
+    /**
+     * Cancels the run if it is still going, waits for the worker to exit and
+     * rebinds the algorithm to the target image.
+     */
+    ~AlgorithmJob();
+
+    AlgorithmJob(const AlgorithmJob &) = delete;
+    AlgorithmJob &operator=(const AlgorithmJob &) = delete;
+
+    /**
+     * @return true once run() has returned (normally, cancelled or by throwing).
+     */
+    [[nodiscard]] bool isFinished() const;
+
+    /**
+     * @return the progress reported by the algorithm, in [0, 1].
+     */
+    [[nodiscard]] float getProgress() const;
+
+    /**
+     * @return the algorithm this job runs.
+     */
+    [[nodiscard]] const Algorithm &getAlgorithm() const { return algorithm; }
+
+    /**
+     * Requests cooperative cancellation; the result of a cancelled job is discarded.
+     */
+    void cancel();
+
+    /**
+     * Waits for the worker, rebinds the algorithm to the target image and, unless the job
+     * was cancelled or failed, replaces the target with the finished snapshot.
+     * Must be called from the thread that owns the target image.
+     * @return true if the result was applied
+     */
+    bool collect();
+
+private:
+    Algorithm &algorithm;
+    PixelArtImage &target;
+    PixelArtImage snapshot;
+    std::atomic<bool> finished{false};
+    std::atomic<bool> cancelled{false};
+    std::atomic<bool> failed{false};
+    std::thread worker;
+};
+
+#endif //ALGORITHMJOB_H
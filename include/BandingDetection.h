@@ -10,8 +10,14 @@
 #include <vector>
 #include <iostream>
 #include "../include/PixelArtImage.h"
+#include "BitboardBandingDetector.h"
+#include "MemoryStats.h"
+#include "Orientation.h"
+#include "Profiler.h"
+#include "TaskScheduler.h"
 #include "imgui.h"
 #include <glm/glm.hpp>
+#include <algorithm>
 #include <unordered_set>
 #include <set>
 
@@ -25,48 +31,76 @@ public:
         return "Banding Detection";
     }
 
+    [[nodiscard]] std::string parameters() const override {
+        return engine == Engine::Bitboard ? "engine=bitboard" : "engine=reference";
+    }
+
     /**
-     * Performs banding detection on a pixel art image by analyzing both horizontal
-     * and vertical segments in the image to identify and group consecutive areas
-     * prone to banding artifacts.
-     *
-     * The method processes the image to determine affected segment pairs,
-     * groups consecutive banding segments into rectangular bounds, and aggregates
-     * unique affected segments for further usage.
-     *
-     * @return A tuple containing:
-     *         - An integer error value representing the banding error of the image.
-     *         - A vector of unique pixel segments affected by banding (a flattened list of all banding pairs)
-     *         - A vector of pairs where each pair represents a pair of banding pixel segments;
-     *         the list is sorted to have all horizontal segments first, and then all vertical ones
+     * Detection back-ends. Both count the same distinct banding pairs; the bitboard engine works on
+     * the palette index plane 64 columns at a time, the reference engine compares clustered segments,
+     * with its horizontal and vertical passes running concurrently.
+     * The reference engine is also used whenever the image has no valid palette index.
      */
-    std::tuple<int, std::vector<std::vector<Pixel>>, std::vector<std::pair<std::vector<Pixel>, std::vector<Pixel>>>> bandingDetection() {
-        for (int i = 0; i < getPixelArtImage().getWidth(); i++) {
-            for (int j = 0; j < getPixelArtImage().getHeight(); j++) {
-                getPixelArtImage().setPixel({i, j}, getPixelArtImage().getPixel({i, j}).color);
-            }
-        }
+    enum class Engine {
+        Bitboard,
+        Reference
+    };
 
-        error = 0;
-        debugPixels.clear();
-        getPixelArtImage().clearDebugLines();
+    /**
+     * The outcome of a banding detection. It holds copies of the affected pixels and does not refer
+     * to the image it was computed on.
+     */
+    struct Report {
+        int error = 0; // number of distinct banding pairs
+        std::vector<std::vector<Pixel>> segments; // every segment of a banding pair, once
+        std::vector<std::pair<std::vector<Pixel>, std::vector<Pixel>>> pairs; // horizontal pairs first
+        size_t horizontalPairs = 0; // pairs[0, horizontalPairs) are horizontal, the rest vertical
+    };
 
-        // Both
-        std::vector<std::pair<std::vector<Pixel>, std::vector<Pixel>>> horizontalAffectedSegmentPairs;
-        getPixelArtImage().segmentClusters(true);
-        auto newPairs = runDetection(true);
-        horizontalAffectedSegmentPairs.insert(horizontalAffectedSegmentPairs.end(), newPairs.begin(), newPairs.end());
+    /**
+     * Detects banding on the top layer of an image without modifying it: no pixels, clusters or
+     * debug lines are written. Any number of threads may run it on the same image at once.
+     *
+     * @param image the image to analyze
+     * @param engine the detection back-end
+     * @return the banding error, the affected segments and the banding pairs
+     */
+    static Report detect(const PixelArtImage &image, Engine engine = Engine::Bitboard) {
+        PF_PROFILE_SCOPE("BandingDetection::detect");
+        Report report;
 
+        std::vector<std::pair<std::vector<Pixel>, std::vector<Pixel>>> horizontalAffectedSegmentPairs;
         std::vector<std::pair<std::vector<Pixel>, std::vector<Pixel>>> verticalAffectedSegmentPairs;
-        getPixelArtImage().segmentClusters(false);
-        newPairs = runDetection(false);
-        verticalAffectedSegmentPairs.insert(verticalAffectedSegmentPairs.end(), newPairs.begin(), newPairs.end());
-
-
-        // Draw rectangles around groups of consecutive banding segments
-        drawGroupedRectangles(horizontalAffectedSegmentPairs, true);
-        drawGroupedRectangles(verticalAffectedSegmentPairs, false);
 
+        const PaletteIndex &paletteIndex = image.getPaletteIndex();
+        if (engine == Engine::Bitboard && paletteIndex.isValid()) {
+            auto result = BitboardBandingDetector::detect(paletteIndex, image.getWidth(), image.getHeight(),
+                                                          PixelArtImage::SUBJECT_THRESHOLD);
+            report.error = result.error;
+
+            // Materializing the segments is the costly part on large images; pairs are independent
+            std::vector<std::pair<std::vector<Pixel>, std::vector<Pixel>>> segmentPairs(result.pairs.size());
+            parallelFor(0, static_cast<int>(result.pairs.size()), 256, [&](int i) {
+                const auto &pair = result.pairs[i];
+                segmentPairs[i] = {pairSegment(image, pair, pair.line), pairSegment(image, pair, pair.line + 1)};
+            });
+            for (size_t i = 0; i < result.pairs.size(); ++i) {
+                auto &pairs = result.pairs[i].horizontal ? horizontalAffectedSegmentPairs : verticalAffectedSegmentPairs;
+                pairs.push_back(std::move(segmentPairs[i]));
+            }
+        } else {
+            // The passes only read the image and each owns its clusters and pairs, so they run concurrently;
+            // the merge below keeps horizontal pairs first whichever pass finishes first
+            TaskGroup group;
+            group.run([&] {
+                horizontalAffectedSegmentPairs = runDetection<Horizontal>(image.computeClusters<Horizontal>());
+            });
+            group.run([&] {
+                verticalAffectedSegmentPairs = runDetection<Vertical>(image.computeClusters<Vertical>());
+            });
+            group.wait();
+            report.error = static_cast<int>(horizontalAffectedSegmentPairs.size() + verticalAffectedSegmentPairs.size());
+        }
 
         // Save unique segments
         struct SegmentHash {
@@ -90,11 +124,13 @@ public:
         };
 
         std::unordered_set<std::vector<Pixel>, SegmentHash, SegmentEqual> seen;
-        std::vector<std::vector<Pixel>> flattened;
+        std::vector<std::vector<Pixel>> &flattened = report.segments;
 
-        std::vector<std::pair<std::vector<Pixel>, std::vector<Pixel>>> affectedSegmentPairs;
-        affectedSegmentPairs.insert(affectedSegmentPairs.end(), horizontalAffectedSegmentPairs.begin(), horizontalAffectedSegmentPairs.end());
-        affectedSegmentPairs.insert(affectedSegmentPairs.end(), verticalAffectedSegmentPairs.begin(), verticalAffectedSegmentPairs.end());
+        std::vector<std::pair<std::vector<Pixel>, std::vector<Pixel>>> &affectedSegmentPairs = report.pairs;
+        report.horizontalPairs = horizontalAffectedSegmentPairs.size();
+        affectedSegmentPairs = std::move(horizontalAffectedSegmentPairs);
+        affectedSegmentPairs.insert(affectedSegmentPairs.end(), std::make_move_iterator(verticalAffectedSegmentPairs.begin()),
+                                    std::make_move_iterator(verticalAffectedSegmentPairs.end()));
 
         for (const auto& pair : affectedSegmentPairs) {
             const auto& segA = pair.first;
@@ -108,10 +144,77 @@ public:
             }
         }
 
-        return std::tuple{error, flattened, affectedSegmentPairs};
+        size_t pairBytes = MemoryStats::vectorBytes(affectedSegmentPairs) + MemoryStats::vectorBytes(flattened);
+        for (const auto &[segA, segB]: affectedSegmentPairs)
+            pairBytes += MemoryStats::vectorBytes(segA) + MemoryStats::vectorBytes(segB);
+        for (const auto &segment: flattened) pairBytes += MemoryStats::vectorBytes(segment);
+        MemoryStats::recordStage("bandingDetection", pairBytes);
+
+        return report;
+    }
+
+    /**
+     * Draws red rectangles around groups of consecutive banding segments onto an image's debug lines,
+     * replacing its previous debug lines. This is the optional, mutating half of a detection.
+     *
+     * @param report a detection of the image
+     * @param image the image to draw on
+     */
+    static void visualize(const Report &report, PixelArtImage &image) {
+        image.clearDebugLines();
+        std::vector<std::vector<Pixel>> horizontal, vertical;
+        for (size_t i = 0; i < report.pairs.size(); ++i) {
+            auto &segments = i < report.horizontalPairs ? horizontal : vertical;
+            segments.push_back(report.pairs[i].first);
+            segments.push_back(report.pairs[i].second);
+        }
+        drawGroupedRectangles<Horizontal>(image, horizontal);
+        drawGroupedRectangles<Vertical>(image, vertical);
+    }
+
+    /**
+     * Redraws the banding overlay from a flat list of affected segments, e.g. after a local correction
+     * updated them without a new detection. The rectangles are the same as visualize() draws for a
+     * report with these segments.
+     *
+     * @param segments the affected segments, each longer than one pixel
+     * @param image the image to draw on
+     */
+    static void visualize(const std::vector<std::vector<Pixel>> &segments, PixelArtImage &image) {
+        image.clearDebugLines();
+        std::vector<std::vector<Pixel>> horizontal, vertical;
+        for (const auto &segment: segments)
+            (segment.front().pos.y == segment.back().pos.y ? horizontal : vertical).push_back(segment);
+        drawGroupedRectangles<Horizontal>(image, horizontal);
+        drawGroupedRectangles<Vertical>(image, vertical);
+    }
+
+    /**
+     * Performs banding detection on the bound image and visualizes it: red rectangles are drawn
+     * around groups of consecutive banding segments. See detect() for a side-effect-free query.
+     *
+     * @return A tuple containing:
+     *         - An integer error value representing the banding error of the image.
+     *         - A vector of unique pixel segments affected by banding (a flattened list of all banding pairs)
+     *         - A vector of pairs where each pair represents a pair of banding pixel segments;
+     *         the list is sorted to have all horizontal segments first, and then all vertical ones
+     */
+    std::tuple<int, std::vector<std::vector<Pixel>>, std::vector<std::pair<std::vector<Pixel>, std::vector<Pixel>>>> bandingDetection() {
+        PF_PROFILE_SCOPE("bandingDetection");
+        debugPixels.clear();
+
+        Report report = detect(getPixelArtImage(), engine);
+        error = report.error;
+        visualize(report, getPixelArtImage());
+
+        return std::tuple{report.error, std::move(report.segments), std::move(report.pairs)};
     }
 
 
+    [[nodiscard]] MemoryBreakdown getMemoryUsage() const override {
+        return {{"debugPixels", MemoryStats::vectorBytes(debugPixels)}};
+    }
+
     void run() override {
         bandingDetection();
     }
@@ -126,17 +229,46 @@ public:
     }
 
     void renderUI() override {
+        const char *engines[] = {"Bitboard", "Reference"};
+        int engineIndex = static_cast<int>(engine);
+        ImGui::Text("Detection Engine:");
+        ImGui::SetNextItemWidth(-FLT_MIN);
+        if (ImGui::Combo("##Engine", &engineIndex, engines, IM_ARRAYSIZE(engines)))
+            engine = static_cast<Engine>(engineIndex);
+
         ImGui::Text("Banding pair count: %d", error);
     }
 
+    void setEngine(Engine newEngine) { engine = newEngine; }
+
+    [[nodiscard]] Engine getEngine() const { return engine; }
+
 private:
     std::vector<Pixel> debugPixels;
     int error = 0;
+    Engine engine = Engine::Bitboard;
+
+    // The pixels of one side of a bitboard banding pair
+    static std::vector<Pixel> pairSegment(const PixelArtImage &image, const BitboardBandingDetector::Pair &pair, int line) {
+        std::vector<Pixel> segment;
+        segment.reserve(pair.end - pair.start + 1);
+        for (int i = pair.start; i <= pair.end; ++i)
+            segment.push_back(image.getPixel(pair.horizontal ? Pos{i, line} : Pos{line, i}));
+        return segment;
+    }
 
 
-    std::vector<std::pair<std::vector<Pixel>, std::vector<Pixel>>> runDetection(bool horizontalOrientation) {
-        PixelArtImage &canvas = getPixelArtImage();
-        const auto allClusters = canvas.getClusters();
+    /**
+     * Pairs each segment with its first uncounted aligned partner, visiting segments in cluster order.
+     *
+     * This still counts every aligned pair, as the bitboard engine does. Aligned segments form stacks on
+     * consecutive lines; the inner segments of a stack are enclosed by their partners and so are clusters
+     * of their own, visited in line order, which leaves no pair of the stack without a claimant.
+     */
+    template<typename O>
+    static std::vector<std::pair<std::vector<Pixel>, std::vector<Pixel>>> runDetection(
+        const std::vector<std::vector<std::vector<Pixel>>> &allClusters) {
+        PF_PROFILE_SCOPE("runDetection");
 
         std::vector<std::pair<std::vector<Pixel>, std::vector<Pixel>>> affectedSegmentPairs;
 
@@ -151,7 +283,7 @@ private:
                 std::unordered_set<Pos> segmentAPosSet;
                 for (const auto &p: segmentA) segmentAPosSet.insert(p.pos);
 
-                auto [startA, endA] = getSegmentEndpoints(segmentA, !horizontalOrientation);
+                auto [startA, endA] = getSegmentEndpoints<O>(segmentA);
 
                 bool foundMatchForSegmentA = false;
 
@@ -167,45 +299,21 @@ private:
 
                         if (countedPairs.contains(pairKey)) continue;
 
-                        for (const auto &p: segmentB) {
-                            for (const Pos &n: {
-                                     Pos{p.pos.x + 1, p.pos.y},
-                                     Pos{p.pos.x - 1, p.pos.y},
-                                     Pos{p.pos.x, p.pos.y + 1},
-                                     Pos{p.pos.x, p.pos.y - 1}
-                                 }) {
-                                if (segmentAPosSet.contains(n)) {
-                                    auto [startB, endB] = getSegmentEndpoints(segmentB, !horizontalOrientation);
-                                    auto alignmentOpt = checkEndpointAlignment(startA, endA, startB, endB, !horizontalOrientation);
-
-                                    if (alignmentOpt.has_value()) {
-                                        error++;
-                                        countedPairs.insert(pairKey);
-
-                                        // Color red(255, 0, 0);
-                                        // for (const auto &px: segmentA) {
-                                        //     Pixel redPixel = px;
-                                        //     redPixel.color = red;
-                                        // }
-                                        // for (const auto &px: segmentB) {
-                                        //     Pixel redPixel = px;
-                                        //     redPixel.color = red;
-                                        // }
-
-                                        std::vector<Pixel> combined = segmentA;
-                                        combined.insert(combined.end(), segmentB.begin(), segmentB.end());
-                                        // canvas.drawRectangle(combined, red);
-
-                                        affectedSegmentPairs.emplace_back(segmentA, segmentB);
-
-                                        foundMatchForSegmentA = true;
-                                        break;
-                                    }
-                                }
-                            }
-                            if (foundMatchForSegmentA) break;
+                        // Only a segment on a neighboring line can band with segmentA, and whether it does depends
+                        // on the endpoints alone. segmentA counts its first uncounted aligned partner only
+                        const bool touches = std::ranges::any_of(segmentB, [&](const Pixel &p) {
+                            return segmentAPosSet.contains(p.pos - O::across()) ||
+                                   segmentAPosSet.contains(p.pos + O::across());
+                        });
+                        if (!touches) continue;
+
+                        auto [startB, endB] = getSegmentEndpoints<O>(segmentB);
+                        if (checkEndpointAlignment<O>(startA, endA, startB, endB).has_value()) {
+                            countedPairs.insert(pairKey);
+                            affectedSegmentPairs.emplace_back(segmentA, segmentB);
+                            foundMatchForSegmentA = true;
+                            break;
                         }
-                        if (foundMatchForSegmentA) break;
                     }
                     if (foundMatchForSegmentA) break;
                 }
@@ -217,69 +325,33 @@ private:
     }
 
 
-
-    static std::pair<Pos, Pos> getSegmentEndpoints(const std::vector<Pixel> &segment, bool isVertical) {
-        auto sortedSegment = segment;
-        std::ranges::sort(sortedSegment, [isVertical](const Pixel &a, const Pixel &b) {
-            return isVertical ? a.pos.y < b.pos.y : a.pos.x < b.pos.x;
+    template<typename O>
+    static std::pair<Pos, Pos> getSegmentEndpoints(const std::vector<Pixel> &segment) {
+        const auto [first, last] = std::ranges::minmax_element(segment, {}, [](const Pixel &p) {
+            return O::along(p.pos);
         });
-        return {sortedSegment.front().pos, sortedSegment.back().pos};
+        return {first->pos, last->pos};
     }
 
 
-    // Check if two segments are adjacent and aligned at endpoints
+    // Check if two segments are on neighboring lines and aligned at both endpoints
+    template<typename O>
     static std::optional<std::string> checkEndpointAlignment(const Pos &segStart, const Pos &segEnd,
-                                                             const Pos &neighborStart, const Pos &neighborEnd,
-                                                             bool isVertical) {
-        bool alignStart = false;
-        bool alignEnd = false;
-        bool sticked = false;
-
-        if (isVertical) {
-            // Check if vertically adjacent (x differs by 1)
-            sticked = (std::abs(segStart.x - neighborStart.x) == 1);
-
-            if (!sticked) return std::nullopt;
+                                                             const Pos &neighborStart, const Pos &neighborEnd) {
+        if (std::abs(O::line(segStart) - O::line(neighborStart)) != 1) return std::nullopt;
 
-            // Check endpoint alignment on row (y)
-            alignStart = (segStart.y == neighborStart.y);
-            alignEnd = (segEnd.y == neighborEnd.y);
-
-            if (alignStart && alignEnd) return std::string("both");
-
-            // TODO: COMMENT OUT THE BELOW 2 LINES
-            // if (alignStart) return std::string("top");
-            // if (alignEnd) return std::string("bottom");
-        } else {
-            // Horizontal case: check if horizontally adjacent (y differs by 1)
-            sticked = (std::abs(segStart.y - neighborStart.y) == 1);
-
-            if (!sticked) return std::nullopt;
-
-            // Check endpoint alignment on column (x)
-            alignStart = (segStart.x == neighborStart.x);
-            alignEnd = (segEnd.x == neighborEnd.x);
-
-            if (alignStart && alignEnd) return std::string("both");
-
-            // TODO: COMMENT OUT THE BELOW 2 LINES
-            // if (alignStart) return std::string("left");
-            // if (alignEnd) return std::string("right");
-        }
+        if (O::along(segStart) == O::along(neighborStart) && O::along(segEnd) == O::along(neighborEnd))
+            return std::string("both");
 
         // If no endpoint aligned, no match
         return std::nullopt;
     }
 
-    void drawGroupedRectangles(const std::vector<std::pair<std::vector<Pixel>, std::vector<Pixel>>> &segmentPairs, bool horizontal) const {
+    template<typename O>
+    static void drawGroupedRectangles(PixelArtImage &image, const std::vector<std::vector<Pixel>> &allSegments) {
+        PF_PROFILE_SCOPE("drawGroupedRectangles");
         Color red(255, 0, 0);
 
-        std::vector<std::vector<Pixel>> allSegments;
-        for (auto &pair : segmentPairs) {
-            allSegments.push_back(pair.first);
-            allSegments.push_back(pair.second);
-        }
-
         std::vector<bool> visited(allSegments.size(), false);
         std::vector<std::vector<std::vector<Pixel>>> groupedSegments;
 
@@ -302,21 +374,13 @@ private:
                         const auto& bStart = allSegments[j].front().pos;
                         const auto& bEnd = allSegments[j].back().pos;
 
-                        bool isConsecutive = false;
-
-                        if (horizontal) {
-                            // Consecutive segments must have y differ by 1 and matching x coordinates for both ends
-                            bool yDiff = std::abs(aStart.y - bStart.y) == 1 && std::abs(aEnd.y - bEnd.y) == 1;
-                            bool xMatch = (aStart.x == bStart.x) && (aEnd.x == bEnd.x);
-                            isConsecutive = yDiff && xMatch;
-                        } else {
-                            // Consecutive segments must have x differ by 1 and matching y coordinates for both ends
-                            bool xDiff = std::abs(aStart.x - bStart.x) == 1 && std::abs(aEnd.x - bEnd.x) == 1;
-                            bool yMatch = (aStart.y == bStart.y) && (aEnd.y == bEnd.y);
-                            isConsecutive = xDiff && yMatch;
-                        }
+                        // Consecutive segments lie on neighboring lines and match at both ends
+                        const bool lineDiff = std::abs(O::line(aStart) - O::line(bStart)) == 1 &&
+                                              std::abs(O::line(aEnd) - O::line(bEnd)) == 1;
+                        const bool alongMatch = O::along(aStart) == O::along(bStart) &&
+                                                O::along(aEnd) == O::along(bEnd);
 
-                        if (isConsecutive) {
+                        if (lineDiff && alongMatch) {
                             group.push_back(allSegments[j]);
                             visited[j] = true;
                             added = true;
@@ -334,7 +398,7 @@ private:
             for (const auto &seg : group) {
                 combined.insert(combined.end(), seg.begin(), seg.end());
             }
-            getPixelArtImage().drawRectangle(combined, red);
+            image.drawRectangle(combined, red);
         }
     }
 
@@ -0,0 +1,151 @@
+#ifndef BITBOARDBANDINGDETECTOR_H
+#define BITBOARDBANDINGDETECTOR_H
+
+#pragma once
+#include "PaletteIndex.h"
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+/**
+ * @class BitboardBandingDetector
+ * Banding detection on per-row bitmasks, 64 columns per machine word.
+ *
+ * A banding pair is two runs of different colors in neighbouring rows (or columns) that start
+ * and end at the same coordinates, are longer than one pixel and belong to the subject.
+ * Each row is reduced to a run-start mask S, a run-end mask E, a subject mask M and a
+ * "differs from the row above" mask D:
+ *
+ * - Horizontal pairs between rows r-1 and r start where both rows start a run, the colors differ
+ *   and both pixels are subject. Each start is advanced to the first run end of either row with
+ *   one multi-word addition, (C + ~U) & U with U = E[r-1] | E[r]; the pair exists if that end
+ *   is shared by both rows.
+ * - Vertical runs start where D is set, so vertical pairs are tracked with one "pending" bit
+ *   per column pair that is set where both columns start a run and cleared at the first run
+ *   end of either column; a pending bit that meets a shared end completes a pair.
+ *
+ * Rows are consumed one at a time, so the detector also works on streamed images.
+ * The error is the number of distinct banding pairs.
+ */
+class BitboardBandingDetector {
+public:
+    /**
+     * A banding pair: runs in lines `line` and `line + 1` (rows if horizontal, columns otherwise)
+     * covering [start, end] along the line.
+     */
+    struct Pair {
+        bool horizontal;
+        int line;
+        int start;
+        int end;
+    };
+
+    struct Result {
+        int error = 0;
+        std::vector<Pair> pairs;           // horizontal pairs first, then vertical ones
+        std::vector<int> rowPairCounts;    // [y]: horizontal pairs between rows y and y + 1
+        std::vector<int> columnPairCounts; // [x]: vertical pairs between columns x and x + 1
+    };
+
+    /**
+     * @param width row length in pixels
+     * @param collectPairs false to only count, e.g. for scoring; the per-row counts are then not kept
+     *                     either, so the detector's memory does not grow with the image height
+     */
+    explicit BitboardBandingDetector(int width, bool collectPairs = true);
+
+    /**
+     * Starts a new image, keeping the storage of the previous one so that a reused detector
+     * does not allocate once it has seen an image of the same size.
+     * @param width row length in pixels
+     * @param collectPairs false to only count, e.g. for scoring; see the constructor
+     */
+    void reset(int width, bool collectPairs = true);
+
+    /**
+     * Consumes the next row.
+     * @param indices the row's palette indices (or any per-pixel color key); all rows must use the same type
+     * @param subjectBits (width + 63) / 64 words, bit x set if pixel x is subject
+     */
+    template<typename T>
+    void pushRow(std::span<const T> indices, const uint64_t *subjectBits);
+
+    /**
+     * Closes the runs of the last row and returns the result.
+     */
+    Result finish();
+
+    /**
+     * Closes the runs of the last row; the result stays in the detector, so reset() can reuse its storage.
+     * @return the result, valid until the next reset()
+     */
+    const Result &close();
+
+    /**
+     * Runs the detector over a whole palette index plane.
+     * @param index a valid palette index
+     * @param width of the image
+     * @param height of the image
+     * @param subjectThreshold channel values below this mark a pixel as subject
+     * @param collectPairs false to only count
+     * @return the banding pairs and counts
+     */
+    static Result detect(const PaletteIndex &index, int width, int height, int subjectThreshold,
+                         bool collectPairs = true);
+
+    /**
+     * Finds the horizontal banding pairs between consecutive rows in [firstRow, lastRow] of an index plane.
+     * Applied to a transposed plane, it finds vertical pairs; pairs are in the plane's coordinates either way.
+     * @param plane row-major palette indices, `width` per row
+     * @param width row length
+     * @param firstRow first row of the band
+     * @param lastRow last row of the band
+     * @param subjectEntries whether each palette entry is subject
+     * @return the pairs, row by row, left to right
+     */
+    template<typename T>
+    static std::vector<Pair> detectRowPairs(std::span<const T> plane, int width, int firstRow, int lastRow,
+                                            const std::vector<bool> &subjectEntries);
+
+    /**
+     * @param index a palette index
+     * @param subjectThreshold channel values below this mark a pixel as subject
+     * @return whether each palette entry is subject
+     */
+    static std::vector<bool> subjectPalette(const PaletteIndex &index, int subjectThreshold);
+
+    /**
+     * @return the bytes held by the detector's row state and result
+     */
+    [[nodiscard]] size_t memoryBytes() const;
+
+private:
+    int width = 0;
+    int words = 0;
+    int rows = 0;
+    bool collectPairs = true;
+
+    // State of the previous row
+    std::vector<std::byte> previousRow;
+    std::vector<uint64_t> previousStarts;
+    std::vector<uint64_t> previousEnds;
+    std::vector<uint64_t> previousSubject;
+    std::vector<uint64_t> previousVerticalStarts;
+
+    // Vertical pairs still open: bit x covers columns x - 1 and x
+    std::vector<uint64_t> pending;
+    std::vector<int> pendingStartRow;
+
+    // Scratch
+    std::vector<uint64_t> starts, ends, differences, scratch;
+
+    Result result;
+    std::vector<Pair> verticalPairs;
+
+    void computeEnds(const std::vector<uint64_t> &runStarts, std::vector<uint64_t> &runEnds) const;
+    void horizontalStep(int row, const uint64_t *subjectBits);
+    void verticalStep(int row, const uint64_t *verticalEnds);
+};
+
+#endif //BITBOARDBANDINGDETECTOR_H
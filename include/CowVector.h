@@ -0,0 +1,118 @@
+#ifndef COWVECTOR_H
+#define COWVECTOR_H
+
+#pragma once
+#include <cstddef>
+#include <memory>
+#include <utility>
+#include <vector>
+
+/**
+ * @class CowVector
+ * A reference-counted, copy-on-write std::vector.
+ *
+ * Copies share the elements and cost one reference count increment; the first write() through a
+ * copy whose elements are shared clones them, so the copies never observe each other's writes.
+ * Moves transfer the elements and leave the source empty. Reads never clone.
+ *
+ * Like std::vector, one object must not be written from one thread while it is used from another.
+ * Different copies may be used from different threads freely.
+ */
+template<typename T>
+class CowVector {
+public:
+    CowVector() : data(emptyData()) {
+    }
+
+    /**
+     * @param size number of elements
+     * @param value the value of every element
+     */
+    explicit CowVector(size_t size, const T &value = T{}) : data(std::make_shared<std::vector<T> >(size, value)) {
+    }
+
+    CowVector(const CowVector &other) = default;
+
+    CowVector(CowVector &&other) noexcept : data(std::exchange(other.data, emptyData())) {
+    }
+
+    CowVector &operator=(const CowVector &other) = default;
+
+    CowVector &operator=(CowVector &&other) noexcept {
+        if (this != &other) data = std::exchange(other.data, emptyData());
+        return *this;
+    }
+
+    /**
+     * @return the elements, shared with the copies that did not write since
+     */
+    [[nodiscard]] const std::vector<T> &read() const { return *data; }
+
+    /**
+     * Clones the elements if they are shared with another copy.
+     * @return the elements, owned by this object alone until it is copied again
+     */
+    std::vector<T> &write() {
+        if (data.use_count() > 1) data = std::make_shared<std::vector<T> >(*data);
+        return *data;
+    }
+
+    /**
+     * Replaces the elements without cloning the shared ones first.
+     * @param size number of elements
+     * @param value the value of every element
+     */
+    void assign(size_t size, const T &value) {
+        if (data.use_count() > 1)
+            data = std::make_shared<std::vector<T> >(size, value);
+        else
+            data->assign(size, value);
+    }
+
+    /**
+     * Replaces the elements without cloning the shared ones first.
+     * @param elements the new elements
+     */
+    void assign(std::vector<T> elements) {
+        if (data.use_count() > 1)
+            data = std::make_shared<std::vector<T> >(std::move(elements));
+        else
+            *data = std::move(elements);
+    }
+
+    /**
+     * Empties the vector; shared elements are released rather than cloned.
+     */
+    void clear() {
+        if (data.use_count() > 1)
+            data = emptyData();
+        else
+            data->clear();
+    }
+
+    [[nodiscard]] const T &operator[](size_t index) const { return (*data)[index]; }
+
+    [[nodiscard]] size_t size() const { return data->size(); }
+
+    [[nodiscard]] bool empty() const { return data->empty(); }
+
+    [[nodiscard]] auto begin() const { return data->cbegin(); }
+
+    [[nodiscard]] auto end() const { return data->cend(); }
+
+    /**
+     * @return true if another copy holds the same elements
+     */
+    [[nodiscard]] bool isShared() const { return data.use_count() > 1; }
+
+private:
+    std::shared_ptr<std::vector<T> > data;
+
+    // Shared by every empty vector, so default construction and moves allocate nothing; never written
+    static const std::shared_ptr<std::vector<T> > &emptyData() {
+        static const auto empty = std::make_shared<std::vector<T> >();
+        return empty;
+    }
+};
+
+#endif //COWVECTOR_H
@@ -0,0 +1,87 @@
+#ifndef FRAMESEQUENCE_H
+#define FRAMESEQUENCE_H
+
+#pragma once
+#include "PixelArtImage.h"
+#include <opencv2/core/mat.hpp>
+#include <string>
+#include <vector>
+
+/**
+ * @class FrameSequence
+ * The frames of an animation, read one at a time from numbered files or from a horizontal strip.
+ *
+ * Consecutive frames of walk cycles and idle animations differ in small regions only;
+ * diff() finds those regions so that analysis and correction can be limited to them.
+ */
+class FrameSequence {
+public:
+    /**
+     * Where a frame differs from the previous one.
+     */
+    struct FrameDiff {
+        bool resized = false;       // the frames have different sizes; nothing can be reused
+        int changedPixels = 0;
+        std::vector<bool> rows;     // [y]: some pixel of row y changed
+        std::vector<bool> columns;  // [x]: some pixel of column x changed
+        cv::Mat mask;               // CV_8UC1, 255 where the pixel changed
+
+        [[nodiscard]] bool empty() const { return !resized && changedPixels == 0; }
+    };
+
+    /**
+     * @param paths one image per frame, in playback order
+     * @return the sequence
+     */
+    static FrameSequence fromFiles(std::vector<std::string> paths);
+
+    /**
+     * @param path an image holding the frames side by side
+     * @param frameWidth width of one frame, or 0 for square frames
+     * @return the sequence; empty if the strip cannot be loaded or split evenly
+     */
+    static FrameSequence fromStrip(const std::string &path, int frameWidth = 0);
+
+    [[nodiscard]] int getFrameCount() const;
+
+    /**
+     * Loads one frame.
+     * @param index the frame number
+     * @param frame receives the frame
+     * @return true on success
+     */
+    bool loadFrame(int index, PixelArtImage &frame) const;
+
+    /**
+     * @param index the frame number
+     * @return a file name for the frame: the input's own name, or "<strip>_<index>.png" for strips
+     */
+    [[nodiscard]] std::string frameName(int index) const;
+
+    /**
+     * Compares the visible pixels of two frames.
+     * @param previous the earlier frame
+     * @param current the later frame
+     * @return the changed rows, columns and pixels
+     */
+    static FrameDiff diff(const PixelArtImage &previous, const PixelArtImage &current);
+
+    /**
+     * Warm-starts the correction of a frame: every pixel that did not change since the previous frame,
+     * and is not within `margin` pixels of a change, takes the previous frame's corrected color.
+     * @param previousResult the corrected previous frame
+     * @param diff the changes from the previous input frame to `frame`
+     * @param margin distance from a change within which pixels are left as they are
+     * @param frame the frame to correct next
+     */
+    static void carryOver(const PixelArtImage &previousResult, const FrameDiff &diff, int margin, PixelArtImage &frame);
+
+private:
+    std::vector<std::string> paths;
+    std::string stripPath;
+    PixelArtImage strip{0, 0};
+    int frameWidth = 0;
+    int stripFrames = 0;
+};
+
+#endif //FRAMESEQUENCE_H
@@ -9,9 +9,17 @@
 #include "Algorithm.h"
 #include <vector>
 #include <iostream>
+#include <sstream>
 #include "../include/PixelArtImage.h"
+#include "MemoryStats.h"
+#include "Orientation.h"
+#include "Profiler.h"
 #include <glm/glm.hpp>
-#include <unordered_set>
+#include <algorithm>
+#include <array>
+#include <map>
+#include <ranges>
+#include <set>
 
 class GeneralBandingCorrection final : public Algorithm {
 public:
@@ -24,6 +32,13 @@ public:
         return "Banding Correction";
     }
 
+    [[nodiscard]] std::string parameters() const override {
+        std::ostringstream description;
+        description << "operation=" << operationIndex << ";leftOrTop=" << alterLeftOrTopEdge
+                << ";rightOrBottom=" << alterRightOrBottomEdge << ";seed=" << RANDOM_SEED;
+        return description.str();
+    }
+
     void renderUI() override {
         // Operation dropdown
         const char *operations[] = {"Shrink (Copy Neigh. Color)", "Shrink (Average With Neigh. Color)", "Expand Segment"};
@@ -43,112 +58,79 @@ public:
     }
 
     void run() override {
+        PF_PROFILE_SCOPE("GeneralBandingCorrection::run");
         // Uncomment to fix the seed (removes variety: always gives the same result).
-        generator = std::default_random_engine{42};
+        generator = std::default_random_engine{RANDOM_SEED};
 
         PixelArtImage &image = getPixelArtImage();
 
-        auto allClusters = image.getClusters();
         auto selectedSegment = image.getSelectedSegment();
 
         if (selectedSegment.empty()) {
             bool cLeftOrTop = alterLeftOrTopEdge;
             bool cRightOrBottom = alterRightOrBottomEdge;
             // Run the algorithm on all segments until banding error converges
-            auto detection = std::make_unique<BandingDetection>(image);
-
-            auto bandingPairs = std::get<2>(detection->bandingDetection());
+            auto report = BandingDetection::detect(image);
+            image.setError(report.error);
+            image.setAffectedSegments(report.segments);
+            const auto initialPairCount = static_cast<float>(report.pairs.size());
 
-            while (!bandingPairs.empty()) {
+            while (!report.pairs.empty()) {
                 // Select the first affected segment
-                for (const auto& pair: bandingPairs) {
-                    const auto &seg1 = pair.first;
-                    const auto &seg2 = pair.second;
-
-                    // Pick either rightmost segment (if vertical) or bottom segment (if horizontal)
-                    // This propagates the error all the way to the bottom right corner,
-                    // Ensuring that the loop ends eventually
-                    std::vector<Pixel> affectedSegment;
-                    bool horizontal = isSegmentHorizontal(seg1);
-
-                    if (horizontal) {
-                        if (seg1.front().pos.x > seg2.front().pos.x) {
-                            affectedSegment = seg1;
-                        } else {
-                            affectedSegment = seg2;
-                        }
-                    } else {
-                        if (seg1.front().pos.y > seg2.front().pos.y) {
-                            affectedSegment = seg1;
-                        } else {
-                            affectedSegment = seg2;
-                        }
+                for (const auto& pair: report.pairs) {
+                    if (isCancelled()) {
+                        BandingDetection::visualize(report, image);
+                        return;
                     }
 
-                    image.segmentClusters(horizontal);
-                    allClusters = image.getClusters();
-
-                    // Find the segment in allClusters that matches 'first' by comparing contents
-                    selectedSegment.clear();
-                    for (const auto &cluster: allClusters) {
-                        for (const auto &seg: cluster) {
-                            if (seg.size() == affectedSegment.size()) {
-                                bool equal = true;
-                                for (size_t i = 0; i < seg.size(); ++i) {
-                                    if (seg[i].pos != affectedSegment[i].pos || seg[i].color != affectedSegment[i].color) {
-                                        equal = false;
-                                        break;
-                                    }
-                                }
-                                if (equal) {
-                                    selectedSegment = seg;
-                                    break;
-                                }
-                            }
-                        }
-                    }
+                    const auto &seg1 = pair.first;
+                    const auto &seg2 = pair.second;
 
-                    image.setSelectedSegment(selectedSegment);
+                    withOrientation(isSegmentHorizontal(seg1), [&]<typename O>(O) {
+                        // Pick either rightmost segment (if vertical) or bottom segment (if horizontal)
+                        // This propagates the error all the way to the bottom right corner,
+                        // Ensuring that the loop ends eventually
+                        const std::vector<Pixel> &affectedSegment =
+                                O::along(seg1.front().pos) > O::along(seg2.front().pos) ? seg1 : seg2;
 
-                    horizontal = isSegmentHorizontal(selectedSegment);
-                    allClusters = image.segmentClusters(horizontal);
+                        // Earlier fixes in this pass may have altered the segment; only fix it if it is still intact
+                        selectedSegment = runThrough<O>(image, affectedSegment.front().pos);
+                        if (selectedSegment != affectedSegment) return;
 
-                    // Extract neighboring segments based on current selection
-                    std::vector<std::vector<Pixel> > neighboringSegments = extractNeighboringSegments(selectedSegment, horizontal, allClusters);
+                        std::vector<std::vector<Pixel> > neighboringSegments =
+                                extractAdjacentLineSegments<O>(image, selectedSegment);
 
-                    // Apply banding correction
-                    image.setPixels(getReplacements(selectedSegment, neighboringSegments, image));
+                        // Apply banding correction
+                        image.setPixels(getReplacements<O>(selectedSegment, neighboringSegments, image));
 
-                    // Reset parameters
-                    alterLeftOrTopEdge = cLeftOrTop;
-                    alterRightOrBottomEdge = cRightOrBottom;
+                        // Reset parameters
+                        alterLeftOrTopEdge = cLeftOrTop;
+                        alterRightOrBottomEdge = cRightOrBottom;
+                    });
                 }
-                detection = std::make_unique<BandingDetection>(image);
-                auto [err, aff, _] = detection->bandingDetection();
-                image.setError(err);
-                bandingPairs = std::get<2>(detection->bandingDetection());
-            }
-        } else {
-
-            // Extract adjacent segments to the selected segments
-            // for horizontal segments, consider only the top and bottom segments
-            // for vertical segments, consider only the left and right segments
-            // (banding can only happen between the selected segment and these neighboring ones)
-            bool horizontal = isSegmentHorizontal(selectedSegment);
-            allClusters = image.segmentClusters(horizontal);
-
-            std::vector<std::vector<Pixel> > neighboringSegments = extractNeighboringSegments(selectedSegment, horizontal, allClusters);
+                report = BandingDetection::detect(image);
+                image.setError(report.error);
+                image.setAffectedSegments(report.segments);
+                MemoryStats::recordStage("generalBandingCorrection", MemoryStats::total(image.getMemoryUsage()));
 
-            // Banding detection and correction
-            if (detectBanding(selectedSegment, neighboringSegments)) {
-                image.setPixels(getReplacements(selectedSegment, neighboringSegments, image));
+                // The loop has no fixed iteration count; report how much of the initial error is gone
+                reportProgress(1.0f - static_cast<float>(report.pairs.size()) / initialPairCount);
             }
+            BandingDetection::visualize(report, image);
+        } else {
+            // Banding can only happen between the selected segment and the runs directly above and below it
+            // (or left and right of it, for vertical segments), so only those two lines are scanned
+            withOrientation(isSegmentHorizontal(selectedSegment), [&]<typename O>(O) {
+                std::vector<std::vector<Pixel> > neighboringSegments =
+                        extractAdjacentLineSegments<O>(image, selectedSegment);
+
+                // Banding detection and correction
+                if (detectBanding<O>(selectedSegment, neighboringSegments)) {
+                    applyLocalCorrection(image, getReplacements<O>(selectedSegment, neighboringSegments, image));
+                }
+            });
         }
 
-        // Final cleanup
-        auto detection = std::make_unique<BandingDetection>(originalCanvas);
-        image.setAffectedSegments(std::get<1>(detection->bandingDetection()));
-        image.setError(std::get<0>(detection->bandingDetection()));
         image.clearSelectedSegment();
         image.clearHighlightedPixels();
     }
@@ -160,23 +142,24 @@ public:
     }
 
 private:
-    PixelArtImage originalCanvas = PixelArtImage(0, 0);
     bool alterLeftOrTopEdge = true;
     bool alterRightOrBottomEdge = true;
     int operationIndex = 0;
-    std::default_random_engine generator{42}; // Seed for reproducibility
+    static constexpr unsigned RANDOM_SEED = 42;
+    std::default_random_engine generator{RANDOM_SEED}; // Seed for reproducibility
 
 
-    [[nodiscard]] bool detectBanding(const std::vector<Pixel> &selectedSegment,
-                                     const std::vector<std::vector<Pixel> > &neighboringSegments) const {
+    template<typename O>
+    [[nodiscard]] static bool detectBanding(const std::vector<Pixel> &selectedSegment,
+                                            const std::vector<std::vector<Pixel> > &neighboringSegments) {
         bool bandingDetected = false;
-        auto [selStart, selEnd] = getSegmentEndpoints(selectedSegment);
+        auto [selStart, selEnd] = getSegmentEndpoints<O>(selectedSegment);
         if (selStart == selEnd) return false;
 
         auto colorA = selectedSegment.front().color;
 
         for (const auto &neighboringSegment: neighboringSegments) {
-            auto [nbStart, nbEnd] = getSegmentEndpoints(neighboringSegment);
+            auto [nbStart, nbEnd] = getSegmentEndpoints<O>(neighboringSegment);
 
             if (nbStart == nbEnd) continue;
 
@@ -184,7 +167,7 @@ private:
             if (colorB == colorA)
                 continue;
 
-            auto alignmentOpt = checkEndpointAlignment(selStart, selEnd, nbStart, nbEnd);
+            auto alignmentOpt = checkEndpointAlignment<O>(selStart, selEnd, nbStart, nbEnd);
             if (alignmentOpt.has_value()) {
                 bandingDetected = true;
                 break;
@@ -194,115 +177,89 @@ private:
         return bandingDetected;
     }
 
-    [[nodiscard]] static std::vector<std::vector<Pixel> > extractNeighboringSegments(
-        const std::vector<Pixel> &selectedSegment,
-        bool horizontal,
-        const std::vector<std::vector<std::vector<Pixel> > > &allClusters) {
-        std::vector<std::vector<Pixel> > neighboringSegments;
-
-        // For fast lookup of positions: convert selected segment to a set of positions
-        std::unordered_set<Pos> selectedSet;
-        for (const auto &p: selectedSegment) {
-            selectedSet.insert(p.pos);
-        }
+    /**
+     * Walks the maximal run of same-colored subject pixels that contains a position.
+     *
+     * @param image the image to read
+     * @tparam O Horizontal to walk along the row, Vertical to walk along the column
+     * @param image the image to read
+     * @param pos a pixel of the run
+     * @return the run's pixels in increasing x (or y) order; empty if pos is outside the image or not subject
+     */
+    template<typename O>
+    [[nodiscard]] static std::vector<Pixel> runThrough(const PixelArtImage &image, Pos pos) {
+        auto inside = [&](const Pos &p) {
+            return p.x >= 0 && p.y >= 0 && p.x < image.getWidth() && p.y < image.getHeight();
+        };
+        if (!inside(pos)) return {};
 
-        for (const auto &cluster: allClusters) {
-            bool containsSelectedSegment = false;
+        const Color color = image.getPixel(pos).color;
+        if (!PixelArtImage::isSubjectColor(color)) return {};
 
-            // Check if this cluster contains the selectedSegment and skip if so
-            for (const auto &segment: cluster) {
-                if (&segment == &selectedSegment) {
-                    // Compare addresses for identity
-                    containsSelectedSegment = true;
-                    break;
-                }
-            }
+        const Pos step = O::step();
+        auto continuesRun = [&](const Pos &p) {
+            return inside(p) && image.getPixel(p).color == color;
+        };
 
-            if (containsSelectedSegment) continue;
-
-            // Take the segments that neighbor the selected segment: for horizontal segments, consider only the top and bottom segments
-            // for vertical segments, consider only the left and right segments
-            for (const auto &segment: cluster) {
-                for (const auto &p: segment) {
-                    std::vector<Pos> neighbors;
-
-                    if (horizontal) {
-                        // Check only top and bottom
-                        neighbors = {
-                            Pos{p.pos.x, p.pos.y - 1}, // Top
-                            Pos{p.pos.x, p.pos.y + 1} // Bottom
-                        };
-                    } else {
-                        // Check only left and right
-                        neighbors = {
-                            Pos{p.pos.x - 1, p.pos.y}, // Left
-                            Pos{p.pos.x + 1, p.pos.y} // Right
-                        };
-                    }
+        Pos start = pos;
+        while (continuesRun(start - step)) start -= step;
 
-                    for (const Pos &n: neighbors) {
-                        if (selectedSet.contains(n)) {
-                            neighboringSegments.push_back(segment);
-                            goto next_segment; // skip the rest of the current segment
-                        }
-                    }
-                }
-            next_segment:;
-            }
+        std::vector<Pixel> run;
+        for (Pos p = start; continuesRun(p); p += step) {
+            run.push_back(image.getPixel(p));
         }
+        return run;
+    }
 
-        return neighboringSegments;
+    /**
+     * Extracts the runs of one row (or column) that overlap a range, without segmenting the rest of the image.
+     *
+     * @tparam O orientation of the runs
+     * @param image the image to read
+     * @param line the row index if horizontal, otherwise the column index
+     * @param from first coordinate of the range along the line
+     * @param to last coordinate of the range along the line (inclusive)
+     * @return the overlapping runs, each extended to its full length
+     */
+    template<typename O>
+    [[nodiscard]] static std::vector<std::vector<Pixel> > extractLineSegments(const PixelArtImage &image, int line,
+                                                                              int from, int to) {
+        std::vector<std::vector<Pixel> > segments;
+        for (int i = from; i <= to; ++i) {
+            auto run = runThrough<O>(image, O::at(line, i));
+            if (run.empty()) continue;
+
+            i = O::along(run.back().pos);
+            segments.push_back(std::move(run));
+        }
+        return segments;
     }
 
     // Returns matched neighbor cluster index or -1 if no match.
     // Returns optional pair {matchedNeighborIndex, alignment} or std::nullopt if no match
-    [[nodiscard]] std::pair<Pos, Pos> getSegmentEndpoints(const std::vector<Pixel> &segment) const {
-        auto sortedSegment = segment;
-        bool horizontal = isSegmentHorizontal(sortedSegment);
-        std::ranges::sort(sortedSegment, [this, horizontal](const Pixel &a, const Pixel &b) {
-            return !horizontal ? a.pos.y < b.pos.y : a.pos.x < b.pos.x;
+    template<typename O>
+    [[nodiscard]] static std::pair<Pos, Pos> getSegmentEndpoints(const std::vector<Pixel> &segment) {
+        const auto [first, last] = std::ranges::minmax_element(segment, {}, [](const Pixel &p) {
+            return O::along(p.pos);
         });
-        return {sortedSegment.front().pos, sortedSegment.back().pos};
+        return {first->pos, last->pos};
     }
 
-    // Check if two segments are adjacent and aligned at endpoints
+    // Check if two segments are on neighboring lines and aligned at both endpoints
+    template<typename O>
     [[nodiscard]] static std::optional<std::string> checkEndpointAlignment(const Pos &segStart, const Pos &segEnd,
-                                                                    const Pos &neighborStart,
-                                                                    const Pos &neighborEnd) {
-        bool alignStart = false;
-        bool alignEnd = false;
-        bool sticked = false;
-
-        bool horizontal = segStart.x == neighborStart.x;
-
-        if (!horizontal) {
-            // Check if vertically adjacent (x differs by 1)
-            sticked = (std::abs(segStart.x - neighborStart.x) == 1);
+                                                                           const Pos &neighborStart,
+                                                                           const Pos &neighborEnd) {
+        if (std::abs(O::line(segStart) - O::line(neighborStart)) != 1) return std::nullopt;
 
-            if (!sticked) return std::nullopt;
-
-            // Check endpoint alignment on row (y)
-            alignStart = (segStart.y == neighborStart.y);
-            alignEnd = (segEnd.y == neighborEnd.y);
-
-            if (alignStart && alignEnd) return std::string("both");
-        } else {
-            // Horizontal case: check if horizontally adjacent (y differs by 1)
-            sticked = (std::abs(segStart.y - neighborStart.y) == 1);
-
-            if (!sticked) return std::nullopt;
-
-            // Check endpoint alignment on column (x)
-            alignStart = (segStart.x == neighborStart.x);
-            alignEnd = (segEnd.x == neighborEnd.x);
-
-            if (alignStart && alignEnd) return std::string("both");
-        }
+        if (O::along(segStart) == O::along(neighborStart) && O::along(segEnd) == O::along(neighborEnd))
+            return std::string("both");
 
         // If no endpoint aligned, no match
         return std::nullopt;
     }
 
+    template<typename O>
     std::vector<Pixel> getReplacements(std::vector<Pixel> &segment,
                                        const std::vector<std::vector<Pixel> > &neighboringSegments,
                                        const PixelArtImage &canvas) {
@@ -310,24 +267,21 @@ private:
 
         if (segment.empty()) return replacements;
 
-        bool horizontal = isSegmentHorizontal(segment);
-
-        std::ranges::sort(segment, [this, horizontal](const Pixel &a, const Pixel &b) {
-            return horizontal ? a.pos.x < b.pos.x : a.pos.y < b.pos.y;
-        });
+        std::ranges::sort(segment, {}, [](const Pixel &p) { return O::along(p.pos); });
 
         switch (operationIndex) {
             case 0:
             case 1:
-                return handleShrinkOrColorChange(segment, neighboringSegments, canvas);
+                return handleShrinkOrColorChange<O>(segment, neighboringSegments, canvas);
             case 2:
-                return handleExpansion(segment, neighboringSegments, canvas);
+                return handleExpansion<O>(segment, neighboringSegments, canvas);
             default:
                 return replacements;
         }
     }
 
 
+    template<typename O>
     std::vector<Pixel> handleShrinkOrColorChange(std::vector<Pixel> &segment,
                                                  const std::vector<std::vector<Pixel> > &neighboringSegments,
                                                  const PixelArtImage &canvas) {
@@ -361,49 +315,30 @@ private:
         // Avoid edge case with shrink strategy on a segment of length two with
         // both endpoint continuations of the same color; happens for avg color variant.
 
+        constexpr EdgeDirection frontEdge = O::IS_HORIZONTAL ? EdgeDirection::Left : EdgeDirection::Top;
+        constexpr EdgeDirection backEdge = O::IS_HORIZONTAL ? EdgeDirection::Right : EdgeDirection::Bottom;
+
         auto fr = segment.front();
         auto bk = segment.back();
-        if (isSegmentHorizontal(segment)) {
-            if (segment.size() == 2) {
-                auto fr_replacement = determineReplacementColor(fr.pos, canvas, fr.color, EdgeDirection::Left);
-                auto bk_replacement = determineReplacementColor(bk.pos, canvas, bk.color, EdgeDirection::Right);
-
-                if (fr_replacement == bk_replacement) {
-                    alterLeftOrTopEdge = false;
-                    alterRightOrBottomEdge = false;
-                    // Pick one randomly
-                    if (generator() % 2 == 0) {
-                        alterLeftOrTopEdge = true;
-                    } else {
-                        alterRightOrBottomEdge = true;
-                    }
-                }
-            }
-
-            edges.push_back(prepareEdge(alterLeftOrTopEdge, true, EdgeDirection::Left));
-            edges.push_back(prepareEdge(alterRightOrBottomEdge, false, EdgeDirection::Right));
-
-        } else {
-            if (segment.size() == 2) {
-                auto fr_replacement = determineReplacementColor(fr.pos, canvas, fr.color, EdgeDirection::Top);
-                auto bk_replacement = determineReplacementColor(bk.pos, canvas, bk.color, EdgeDirection::Bottom);
-
-                if (fr_replacement == bk_replacement) {
-                    alterLeftOrTopEdge = false;
-                    alterRightOrBottomEdge = false;
-                    // Pick one randomly
-                    if (generator() % 2 == 0) {
-                        alterLeftOrTopEdge = true;
-                    } else {
-                        alterRightOrBottomEdge = true;
-                    }
+        if (segment.size() == 2) {
+            auto fr_replacement = determineReplacementColor(fr.pos, canvas, fr.color, frontEdge);
+            auto bk_replacement = determineReplacementColor(bk.pos, canvas, bk.color, backEdge);
+
+            if (fr_replacement == bk_replacement) {
+                alterLeftOrTopEdge = false;
+                alterRightOrBottomEdge = false;
+                // Pick one randomly
+                if (generator() % 2 == 0) {
+                    alterLeftOrTopEdge = true;
+                } else {
+                    alterRightOrBottomEdge = true;
                 }
             }
-
-            edges.push_back(prepareEdge(alterLeftOrTopEdge, true, EdgeDirection::Top));
-            edges.push_back(prepareEdge(alterRightOrBottomEdge, false, EdgeDirection::Bottom));
         }
 
+        edges.push_back(prepareEdge(alterLeftOrTopEdge, true, frontEdge));
+        edges.push_back(prepareEdge(alterRightOrBottomEdge, false, backEdge));
+
         auto applyEdge = [&](const EdgeOp &e) {
             if (!e.valid || segment.empty()) return;
 
@@ -420,7 +355,7 @@ private:
             applyEdge(e);
         }
 
-        if (!segment.empty() && detectBanding(segment, neighboringSegments)) {
+        if (!segment.empty() && detectBanding<O>(segment, neighboringSegments)) {
             for (const EdgeOp &e: edges) {
                 applyEdge(e);
             }
@@ -429,6 +364,7 @@ private:
         return replacements;
     }
 
+    template<typename O>
     std::vector<Pixel> handleExpansion(std::vector<Pixel> &segment,
                                        const std::vector<std::vector<Pixel> > &neighboringSegments,
                                        const PixelArtImage &canvas) const {
@@ -462,13 +398,8 @@ private:
 
         std::vector<ExpandOp> ops;
 
-        if (isSegmentHorizontal(segment)) {
-            if (alterLeftOrTopEdge) ops.push_back({true, -1, 0, true});
-            if (alterRightOrBottomEdge) ops.push_back({true, 1, 0, false});
-        } else {
-            if (alterLeftOrTopEdge) ops.push_back({true, 0, -1, true});
-            if (alterRightOrBottomEdge) ops.push_back({true, 0, 1, false});
-        }
+        if (alterLeftOrTopEdge) ops.push_back({true, -O::step().x, -O::step().y, true});
+        if (alterRightOrBottomEdge) ops.push_back({true, O::step().x, O::step().y, false});
 
         auto applyOp = [&](const ExpandOp &op) {
             if (!segment.empty()) {
@@ -481,7 +412,7 @@ private:
             applyOp(op);
         }
 
-        if (!segment.empty() && detectBanding(segment, neighboringSegments)) {
+        if (!segment.empty() && detectBanding<O>(segment, neighboringSegments)) {
             for (const auto &op: ops) {
                 applyOp(op); // expand one more time
             }
@@ -490,6 +421,140 @@ private:
         return replacements;
     }
 
+    /**
+     * Extracts the runs of the two lines adjacent to a segment (above and below it, or left and right
+     * of it for vertical segments) that overlap the segment's extent.
+     *
+     * @tparam O orientation of the segment
+     * @param image the image to read
+     * @param segment a run of the image
+     * @return the runs of the previous line followed by those of the next line
+     */
+    template<typename O>
+    [[nodiscard]] static std::vector<std::vector<Pixel> > extractAdjacentLineSegments(const PixelArtImage &image,
+                                                                                      const std::vector<Pixel> &segment) {
+        auto [start, end] = getSegmentEndpoints<O>(segment);
+        const int line = O::line(start);
+        const int from = O::along(start);
+        const int to = O::along(end);
+
+        auto segments = extractLineSegments<O>(image, line - 1, from, to);
+        auto nextLineSegments = extractLineSegments<O>(image, line + 1, from, to);
+        segments.insert(segments.end(), nextLineSegments.begin(), nextLineSegments.end());
+        return segments;
+    }
+
+    using SegmentKey = std::array<int, 4>; // front x, front y, back x, back y
+    using LocalPairs = std::map<SegmentKey, std::pair<std::vector<Pixel>, std::vector<Pixel> > >;
+
+    static SegmentKey segmentKey(const std::vector<Pixel> &segment) {
+        return {segment.front().pos.x, segment.front().pos.y, segment.back().pos.x, segment.back().pos.y};
+    }
+
+    /**
+     * Collects the banding pairs that involve a run through (or directly next to) one of the given pixels,
+     * in both orientations. Pairs further away cannot change when only these pixels are recolored.
+     *
+     * @param image the image to read
+     * @param changed the pixels being recolored
+     * @return the pairs keyed by their upper (or left) segment
+     */
+    [[nodiscard]] static LocalPairs localBandingPairs(const PixelArtImage &image, const std::vector<Pixel> &changed) {
+        LocalPairs pairs;
+
+        auto collect = [&]<typename O>(O) {
+            const Pos along = O::step();
+            const Pos across = O::across();
+
+            for (const auto &pixel: changed) {
+                // Recoloring a pixel can also merge or split the runs right before and after it
+                for (const Pos &pos: {pixel.pos - along, pixel.pos, pixel.pos + along}) {
+                    auto run = runThrough<O>(image, pos);
+                    if (run.size() <= 1) continue;
+
+                    for (const Pos &side: {-across, across}) {
+                        auto partner = runThrough<O>(image, run.front().pos + side);
+                        if (partner.size() != run.size() ||
+                            partner.front().pos != run.front().pos + side ||
+                            partner.front().color == run.front().color)
+                            continue;
+
+                        const bool runFirst = side == across;
+                        auto &upper = runFirst ? run : partner;
+                        auto &lower = runFirst ? partner : run;
+                        pairs.try_emplace(segmentKey(upper), upper, lower);
+                    }
+                }
+            }
+        };
+        collect(Horizontal{});
+        collect(Vertical{});
+
+        return pairs;
+    }
+
+    /**
+     * Tells whether a previously affected segment still exists as a run and still has an aligned partner.
+     */
+    [[nodiscard]] static bool hasBandingPartner(const PixelArtImage &image, const std::vector<Pixel> &segment) {
+        if (segment.size() <= 1) return false;
+
+        return withOrientation(isSegmentHorizontal(segment), [&]<typename O>(O) {
+            auto run = runThrough<O>(image, segment.front().pos);
+            if (run.empty() || segmentKey(run) != segmentKey(segment)) return false;
+
+            for (const Pos &side: {-O::across(), O::across()}) {
+                auto partner = runThrough<O>(image, run.front().pos + side);
+                if (partner.size() == run.size() &&
+                    partner.front().pos == run.front().pos + side &&
+                    partner.front().color != run.front().color)
+                    return true;
+            }
+            return false;
+        });
+    }
+
+    /**
+     * Recolors pixels and updates the image's cached banding error, affected segments and overlay from the
+     * banding pairs around those pixels only, instead of re-running detection on the whole canvas.
+     *
+     * @param image the image to correct
+     * @param replacements the new pixel colors
+     */
+    static void applyLocalCorrection(PixelArtImage &image, const std::vector<Pixel> &replacements) {
+        if (replacements.empty()) return;
+
+        const LocalPairs before = localBandingPairs(image, replacements);
+        image.setPixels(replacements);
+        const LocalPairs after = localBandingPairs(image, replacements);
+
+        image.setError(std::max(0, image.getError() + static_cast<int>(after.size()) - static_cast<int>(before.size())));
+
+        std::set<SegmentKey> touched;
+        for (const auto &[upper, lower]: before | std::views::values) {
+            touched.insert(segmentKey(upper));
+            touched.insert(segmentKey(lower));
+        }
+
+        std::vector<int> removed;
+        std::set<SegmentKey> present;
+        const auto &segments = image.getAffectedSegments();
+        for (size_t id = 0; id < segments.size(); ++id) {
+            const bool stale = touched.contains(segmentKey(segments[id])) && !hasBandingPartner(image, segments[id]);
+            if (stale || !present.insert(segmentKey(segments[id])).second) removed.push_back(static_cast<int>(id));
+        }
+
+        std::vector<std::vector<Pixel> > added;
+        for (const auto &[upper, lower]: after | std::views::values) {
+            if (present.insert(segmentKey(upper)).second) added.push_back(upper);
+            if (present.insert(segmentKey(lower)).second) added.push_back(lower);
+        }
+
+        image.updateAffectedSegments(removed, std::move(added));
+        BandingDetection::visualize(image.getAffectedSegments(), image);
+        image.markBandingCurrent();
+    }
+
     enum class EdgeDirection {
         None,
         Top,
@@ -505,11 +570,11 @@ private:
         const int width = canvas.getWidth();
         const int height = canvas.getHeight();
 
-        auto subjectMask = PixelArtImage::extractSubject(canvas); // [y][x] == true means subject pixel
-
+        // Only the four direct neighbours are inspected, so classify them one by one
+        // instead of building a subject mask of the whole canvas
         auto isInsideSubject = [&](int x, int y) {
             return x >= 0 && y >= 0 && x < width && y < height &&
-                   subjectMask.at<uchar>(y, x) != 0;
+                   PixelArtImage::isSubjectColor(canvas.getPixel({x, y}).color);
         };
 
         std::vector<Color> neighborColors;
@@ -0,0 +1,74 @@
+#ifndef IMAGEVIEW_H
+#define IMAGEVIEW_H
+
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * Memory layouts of the pixels behind an ImageView, 8 bits per channel.
+ * Alpha, where present, is ignored, as when loading an image file.
+ */
+enum class PixelFormat {
+    Gray8,
+    RGB8,
+    BGR8,
+    RGBA8,
+    BGRA8
+};
+
+/**
+ * @struct ImageView
+ * A non-owning view of pixels in memory, e.g. a decoded frame, a cv::Mat or a texture readback.
+ * The viewed memory must outlive every use of the view.
+ */
+struct ImageView {
+    const uint8_t *data = nullptr;
+    int width = 0;
+    int height = 0;
+    size_t stride = 0; // bytes from the start of one row to the start of the next
+    PixelFormat format = PixelFormat::RGBA8;
+
+    /**
+     * Views rows that follow each other without padding.
+     * @param data the first pixel
+     * @param width in pixels
+     * @param height in pixels
+     * @param format the pixel layout
+     * @return the view
+     */
+    static ImageView packed(const uint8_t *data, int width, int height, PixelFormat format) {
+        return {data, width, height, static_cast<size_t>(width) * bytesPerPixel(format), format};
+    }
+
+    /**
+     * @param format a pixel layout
+     * @return the bytes of one pixel
+     */
+    static constexpr int bytesPerPixel(PixelFormat format) {
+        switch (format) {
+            case PixelFormat::Gray8: return 1;
+            case PixelFormat::RGB8:
+            case PixelFormat::BGR8: return 3;
+            case PixelFormat::RGBA8:
+            case PixelFormat::BGRA8: return 4;
+        }
+        return 0;
+    }
+
+    /**
+     * @return true if the view points at memory and its rows do not overlap
+     */
+    [[nodiscard]] bool isValid() const {
+        return width >= 0 && height >= 0 && (width == 0 || height == 0 ||
+                                             (data && stride >= static_cast<size_t>(width) * bytesPerPixel(format)));
+    }
+
+    /**
+     * @param y a row index
+     * @return the first byte of the row
+     */
+    [[nodiscard]] const uint8_t *row(int y) const { return data + static_cast<size_t>(y) * stride; }
+};
+
+#endif //IMAGEVIEW_H
@@ -0,0 +1,66 @@
+#ifndef INCREMENTALBANDINGDETECTOR_H
+#define INCREMENTALBANDINGDETECTOR_H
+
+#pragma once
+#include "BitboardBandingDetector.h"
+#include "FrameSequence.h"
+#include "PixelArtImage.h"
+#include <vector>
+
+/**
+ * @class IncrementalBandingDetector
+ * Banding detection over a sequence of frames that only rescans what changed.
+ *
+ * A horizontal banding pair between rows y and y + 1 depends on nothing but those two rows, and a
+ * vertical pair on its two columns. The detector keeps the pairs of the previous frame per row pair
+ * and per column pair; on the next frame only the row pairs touching a changed row and the column
+ * pairs touching a changed column are scanned again, the rest are reused as they are.
+ */
+class IncrementalBandingDetector {
+public:
+    /**
+     * @param subjectThreshold channel values below this mark a pixel as subject
+     */
+    explicit IncrementalBandingDetector(int subjectThreshold = PixelArtImage::SUBJECT_THRESHOLD)
+        : subjectThreshold(subjectThreshold) {
+    }
+
+    /**
+     * Detects the banding of the next frame.
+     * @param frame the frame; its palette index must be valid
+     * @param diff the changes since the previous frame given to update(), or nullptr to scan everything
+     * @return the banding pairs and counts, as BitboardBandingDetector::detect; vertical pairs are
+     *         ordered by column. The error is -1 if the frame has no valid palette index.
+     */
+    BitboardBandingDetector::Result update(const PixelArtImage &frame, const FrameSequence::FrameDiff *diff);
+
+    /**
+     * @return the rows and columns scanned by the last update()
+     */
+    [[nodiscard]] int getScannedLines() const { return scannedLines; }
+
+    /**
+     * Forgets the previous frame; the next update() scans everything.
+     */
+    void reset();
+
+private:
+    int subjectThreshold;
+    int width = -1;
+    int height = -1;
+    std::vector<std::vector<BitboardBandingDetector::Pair> > rowPairs;    // [y]: rows y and y + 1
+    std::vector<std::vector<BitboardBandingDetector::Pair> > columnPairs; // [x]: columns x and x + 1
+    int scannedLines = 0;
+
+    /**
+     * Rescans every line pair that touches a changed line.
+     * @param changed [line]: the line changed
+     * @param pairs the per line pair results to update
+     * @param scan scans lines [first, last] and returns their pairs
+     */
+    template<typename Scan>
+    void rescan(const std::vector<bool> &changed, std::vector<std::vector<BitboardBandingDetector::Pair> > &pairs,
+                Scan &&scan);
+};
+
+#endif //INCREMENTALBANDINGDETECTOR_H
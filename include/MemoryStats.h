@@ -0,0 +1,96 @@
+#ifndef MEMORYSTATS_H
+#define MEMORYSTATS_H
+
+#pragma once
+#include <cstddef>
+#include <opencv2/core/mat.hpp>
+#include <string>
+#include <vector>
+
+/**
+ * A named amount of memory held by one structure.
+ */
+struct MemoryItem {
+    std::string name;
+    size_t bytes = 0;
+};
+
+using MemoryBreakdown = std::vector<MemoryItem>;
+
+/**
+ * @class MemoryStats
+ * Memory accounting for images, cached analysis structures and per-run scratch.
+ *
+ * Structures report their own size (see PixelArtImage::getMemoryUsage() and
+ * Algorithm::getMemoryUsage()); pipeline stages report the bytes they hold while they run,
+ * and the largest report of every stage is kept as its high-water mark. The process-wide
+ * resident set size is available as a cross-check of the accounted numbers.
+ */
+class MemoryStats {
+public:
+    /**
+     * The high-water mark of one pipeline stage.
+     */
+    struct StageStats {
+        std::string name;
+        int samples = 0;
+        size_t peakBytes = 0;
+        size_t lastBytes = 0;
+    };
+
+    /**
+     * Records the bytes a stage holds; safe to call from any thread.
+     * @param stage a string literal naming the stage
+     * @param bytes the bytes held by the stage's live structures
+     */
+    static void recordStage(const char *stage, size_t bytes);
+
+    /**
+     * @return every stage recorded since the last clear(), by name
+     */
+    static std::vector<StageStats> getStageStats();
+
+    /**
+     * Drops the recorded stages.
+     */
+    static void clear();
+
+    /**
+     * @return the process's current resident set size, or 0 where it cannot be queried
+     */
+    static size_t residentBytes();
+
+    /**
+     * @return the process's peak resident set size, or 0 where it cannot be queried
+     */
+    static size_t peakResidentBytes();
+
+    /**
+     * @param breakdown named amounts
+     * @return their sum
+     */
+    static size_t total(const MemoryBreakdown &breakdown);
+
+    /**
+     * @param bytes an amount of memory
+     * @return it in B, KiB, MiB or GiB, e.g. "1.50 MiB"
+     */
+    static std::string formatBytes(size_t bytes);
+
+    /**
+     * @return the heap bytes reserved by a vector of flat elements
+     */
+    template<typename T>
+    static size_t vectorBytes(const std::vector<T> &vector) {
+        return vector.capacity() * sizeof(T);
+    }
+
+    /**
+     * @return the pixel bytes of a matrix
+     */
+    static size_t matBytes(const cv::Mat &mat) {
+        return mat.total() * mat.elemSize();
+    }
+};
+
+#endif //MEMORYSTATS_H
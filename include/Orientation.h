@@ -0,0 +1,65 @@
+#ifndef ORIENTATION_H
+#define ORIENTATION_H
+
+#pragma once
+#include "Pixel.h"
+#include <utility>
+
+/**
+ * Orientation policies for segment kernels. A segment lies on one line (a row or a column) and
+ * extends along it; kernels templated on a policy read positions through its accessors instead
+ * of branching on a runtime flag, so each orientation gets its own branch-free instantiation.
+ *
+ * A policy supplies:
+ *  - along(p): the coordinate of p along its line
+ *  - line(p): the index of the line p lies on
+ *  - at(line, along): the position with those coordinates
+ *  - step(): the offset to the next pixel of the line
+ *  - across(): the offset to the same pixel of the next line
+ */
+struct Horizontal {
+    static constexpr bool IS_HORIZONTAL = true;
+
+    static int along(const Pos &p) { return p.x; }
+
+    static int line(const Pos &p) { return p.y; }
+
+    static Pos at(int line, int along) { return {along, line}; }
+
+    static Pos step() { return {1, 0}; }
+
+    static Pos across() { return {0, 1}; }
+};
+
+/**
+ * @copydoc Horizontal
+ */
+struct Vertical {
+    static constexpr bool IS_HORIZONTAL = false;
+
+    static int along(const Pos &p) { return p.y; }
+
+    static int line(const Pos &p) { return p.x; }
+
+    static Pos at(int line, int along) { return {line, along}; }
+
+    static Pos step() { return {0, 1}; }
+
+    static Pos across() { return {1, 0}; }
+};
+
+/**
+ * Calls a generic function with the policy matching a runtime orientation, e.g. at an API boundary
+ * that still takes a flag. Both instantiations must return the same type.
+ *
+ * @param horizontal true for Horizontal, false for Vertical
+ * @param function called with a default-constructed policy
+ * @return the function's result
+ */
+template<typename Function>
+decltype(auto) withOrientation(bool horizontal, Function &&function) {
+    if (horizontal) return std::forward<Function>(function)(Horizontal{});
+    return std::forward<Function>(function)(Vertical{});
+}
+
+#endif //ORIENTATION_H
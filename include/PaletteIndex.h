@@ -0,0 +1,148 @@
+#ifndef PALETTEINDEX_H
+#define PALETTEINDEX_H
+
+#pragma once
+#include "CowVector.h"
+#include "Pixel.h"
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * @class PaletteIndex
+ * A palette plus one palette index per pixel.
+ *
+ * Pixel art rarely uses more than a few dozen colors, so the index plane is stored with
+ * one byte per pixel and only spills to two bytes once the palette outgrows 256 entries.
+ * Past 65536 colors the index gives up and reports itself invalid; callers then fall back
+ * to comparing colors.
+ *
+ * Palette entries are never removed, so an entry may have no pixels left (see getCount()).
+ */
+class PaletteIndex {
+public:
+    static constexpr size_t NARROW_COLORS = 1 << 8;
+    static constexpr size_t MAX_COLORS = 1 << 16;
+
+    /**
+     * Drops the palette and sizes the plane, with every pixel set to one color.
+     * @param width in pixels
+     * @param height in pixels
+     * @param fill the color of every pixel
+     */
+    void reset(int width, int height, const Color &fill);
+
+    /**
+     * Sets the color of one pixel, adding it to the palette if needed.
+     * @param index pixel index (y * width + x)
+     * @param color the new color
+     * @return false if the palette overflowed and the index is no longer valid
+     */
+    bool assign(size_t index, const Color &color);
+
+    /**
+     * @return false once the palette has overflowed; the plane is then empty
+     */
+    [[nodiscard]] bool isValid() const { return valid; }
+
+    /**
+     * @return true if the plane uses 16-bit indices
+     */
+    [[nodiscard]] bool isWide() const { return wideIndices; }
+
+    /**
+     * @param index pixel index (y * width + x)
+     * @return the palette index of the pixel
+     */
+    [[nodiscard]] uint16_t at(size_t index) const {
+        return wideIndices ? wide[index] : narrow[index];
+    }
+
+    /**
+     * @param id a palette index
+     * @return the color of the palette entry
+     */
+    [[nodiscard]] const Color &getColor(uint16_t id) const { return palette[id]; }
+
+    /**
+     * @param id a palette index
+     * @return how many pixels currently use the palette entry
+     */
+    [[nodiscard]] int getCount(uint16_t id) const { return counts[id]; }
+
+    /**
+     * @return the palette; position in the vector is the palette index
+     */
+    [[nodiscard]] const std::vector<Color> &getPalette() const { return palette; }
+
+    /**
+     * @param color a color
+     * @return its palette index, if the palette contains it
+     */
+    [[nodiscard]] std::optional<uint16_t> find(const Color &color) const;
+
+    /**
+     * Calls f with the plane as a std::span of uint8_t or uint16_t, whichever is in use,
+     * so row kernels can be written once for both widths.
+     */
+    template<typename F>
+    decltype(auto) visitPlane(F &&f) const {
+        if (wideIndices) return f(std::span<const uint16_t>(wide.read()));
+        return f(std::span<const uint8_t>(narrow.read()));
+    }
+
+    /**
+     * Like visitPlane(), but with the plane transposed (column-major: element (x, y) at x * height + y),
+     * so vertical passes can run the same row-oriented kernels with contiguous loads.
+     * The transposed copy is built on first use with a cache-blocked transpose and then kept up to
+     * date by assign(). Concurrent calls are safe, including the first ones; calls concurrent with
+     * assign() are not.
+     */
+    template<typename F>
+    decltype(auto) visitTransposedPlane(F &&f) const {
+        ensureTransposed();
+        if (wideIndices) return f(std::span<const uint16_t>(transposedWide.read()));
+        return f(std::span<const uint8_t>(transposedNarrow.read()));
+    }
+
+    /**
+     * @return the bytes held by the plane, its transposed copy and the palette
+     */
+    [[nodiscard]] size_t memoryBytes() const;
+
+private:
+    int width = 0;
+    int height = 0;
+    bool valid = false;
+    bool wideIndices = false;
+    std::vector<Color> palette;
+    std::vector<int> counts;
+    std::unordered_map<Color, uint16_t> lookup;
+    // The planes are shared between copies until one of them is written
+    CowVector<uint8_t> narrow;
+    CowVector<uint16_t> wide;
+
+    // Serializes the lazy transposition of const, shared indices; copies get a mutex of their own
+    struct TransposeMutex {
+        std::mutex mutex;
+
+        TransposeMutex() = default;
+        TransposeMutex(const TransposeMutex &) noexcept {}
+        TransposeMutex &operator=(const TransposeMutex &) noexcept { return *this; }
+    };
+
+    // Transposed copy of the plane, built lazily
+    mutable TransposeMutex transposeMutex;
+    mutable bool transposedValid = false;
+    mutable CowVector<uint8_t> transposedNarrow;
+    mutable CowVector<uint16_t> transposedWide;
+
+    std::optional<uint16_t> addColor(const Color &color);
+    void ensureTransposed() const;
+    void invalidateTransposed();
+};
+
+#endif //PALETTEINDEX_H
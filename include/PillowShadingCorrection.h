@@ -9,19 +9,30 @@
 #include "Algorithm.h"
 #include <vector>
 #include <iostream>
+#include <sstream>
 #include <opencv2/opencv.hpp>
 #include "../include/PixelArtImage.h"
 #include "imgui.h"
 #include <unordered_map>
 #include <random>
-#include <set>
 #include <glm/glm.hpp>
 #include <unordered_set>
 #include <functional>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <iterator>
 
 #include "../../external/concavehull/src/concavehull.hpp"
 
 #include "BandingDetection.h"
+#include "FrameSequence.h"
+#include "IncrementalBandingDetector.h"
+#include "MemoryStats.h"
+#include "Profiler.h"
+#include "TaskScheduler.h"
+#include "ThreadCpuClock.h"
+#include "ViewDetection.h"
 
 template<>
 struct std::hash<std::pair<int, int> > {
@@ -39,42 +50,122 @@ public:
         return "Pillow-Shading Correction";
     }
 
+    [[nodiscard]] std::string parameters() const override {
+        // The engine state is the seed of the next run's trials
+        std::ostringstream description;
+        description << "iterations=" << PIPELINE_ITERATIONS << ";preserveOutline=" << PRESERVE_OUTLINE
+                << ";erosionMode=" << erosionMode << ";linearErosionFactor=" << std::hexfloat << LINEAR_EROSION_FACTOR
+                << ";probabilityAddCandidate=" << PROB_ADD_CANDIDATE_PIXEL << std::defaultfloat
+                << ";random=" << generator;
+        if (searchMode == SearchMode::Annealing) description << ";search=annealing;cpuBudgetMs=" << SEARCH_BUDGET_MS;
+        return description.str();
+    }
+
+    [[nodiscard]] MemoryBreakdown getMemoryUsage() const override {
+        // Trials of one run share their moved layer masks; count each once
+        size_t layerBytes = MemoryStats::vectorBytes(debugLayers);
+        std::unordered_set<const uchar *> counted;
+        for (const auto &layer: debugLayers)
+            if (counted.insert(layer.data).second) layerBytes += MemoryStats::matBytes(layer);
+        return {
+            {"debugLayers", layerBytes},
+            {"neighborCandidates", neighborCandidatesBytes(debugNeighborCandidates)},
+        };
+    }
+
     void run() override {
+        PF_PROFILE_SCOPE("PillowShadingCorrection::run");
         // Uncomment to fix the seed (removes variety: always gives the same result).
         // generator = std::default_random_engine{42};
         PixelArtImage &canvas = getPixelArtImage();
         int width = canvas.getWidth();
         int height = canvas.getHeight();
 
-        std::vector<std::pair<Color, cv::Mat> > layers = extractLayers(canvas);
+        const LayerTable table = extractLayers(canvas);
+        if (table.layers.size() < 2) {
+            MemoryStats::recordStage("extractLayers", table.memoryBytes());
+            return; // safety
+        }
+        std::vector<std::pair<Color, cv::Mat> > layers = fillLayers(table);
 
-        if (layers.size() < 2) return; // safety
+        size_t layerBytes = table.memoryBytes() + MemoryStats::vectorBytes(layers);
+        for (const auto &layer: layers) layerBytes += MemoryStats::matBytes(layer.second);
+        MemoryStats::recordStage("extractLayers", layerBytes);
 
         // Clear debug layers
         debugLayers.clear();
         debugNeighborCandidates.clear();
         showNeighborCandidates = false;
 
-        // Create a blank PixelArtImage for the processed (resulting) picture
-        auto error = 9999999;
-        auto bestCorrectedCanvas = PixelArtImage(width, height);
-        auto bestBandingLines = std::vector<std::tuple<int, int, int> >();
+        const TrialPlan plan = planTrials(width, height, layers);
+
+        // Trials are independent: each gets its own seed, canvas and debug layers, and runs as a task.
+        // Seeds are drawn up front so the result does not depend on scheduling.
+        struct Trial {
+            PixelArtImage canvas{0, 0};
+            int error = 0;
+            std::vector<cv::Mat> debugLayers;
+            std::vector<std::unordered_set<std::pair<int, int> > > neighborCandidates;
+        };
+
+        std::vector<Trial> trials(PIPELINE_ITERATIONS);
+        std::vector<std::default_random_engine::result_type> seeds(PIPELINE_ITERATIONS);
+        for (auto &seed: seeds) seed = generator();
+
+        // In annealing mode every trial is a search chain with an equal share of the CPU-time budget
+        const auto chainBudget = ThreadCpuClock::duration(std::chrono::milliseconds(SEARCH_BUDGET_MS)) /
+                                 PIPELINE_ITERATIONS;
+
+        std::atomic<int> finishedTrials{0};
+        TaskGroup group;
         for (int i = 0; i < PIPELINE_ITERATIONS; ++i) {
-            PixelArtImage correctedCanvas(width, height);
+            group.run([&, i] {
+                if (isCancelled()) return;
+
+                Trial &trial = trials[i];
+                std::default_random_engine random = spawnEngine(seeds[i]);
+
+                if (searchMode == SearchMode::Annealing) {
+                    trial.error = annealCorrectedCanvas(plan, layers, trial.canvas, random, chainBudget,
+                                                        trial.debugLayers, trial.neighborCandidates);
+                } else {
+                    constructCorrectedCanvas(plan, layers, trial.canvas, random, trial.debugLayers,
+                                             trial.neighborCandidates);
+
+                    // Only the count matters here; score the palette plane directly, with one scratch per worker
+                    thread_local DetectionScratch scratch;
+                    trial.error = detectBanding(trial.canvas.getPaletteIndex(), width, height, scratch);
+                    if (trial.error < 0) trial.error = BandingDetection::detect(trial.canvas).error;
+                }
 
-            constructCorrectedCanvas(width, height, layers, correctedCanvas);
+                reportProgress(static_cast<float>(++finishedTrials) / static_cast<float>(PIPELINE_ITERATIONS));
+            });
+        }
+        group.wait();
 
-            auto detection = std::make_unique<BandingDetection>(correctedCanvas);
-            auto newError = std::get<0>(detection->bandingDetection());
+        // All trials are alive together until the best one is picked; their debug layers are the plan's masks
+        size_t trialBytes = layerBytes + plan.memoryBytes();
+        for (const auto &trial: trials)
+            trialBytes += MemoryStats::total(trial.canvas.getMemoryUsage()) + neighborCandidatesBytes(trial.neighborCandidates);
+        MemoryStats::recordStage("pillowTrials", trialBytes);
+        if (isCancelled()) return;
 
-            if (newError < error) {
-                bestCorrectedCanvas = correctedCanvas;
-                error = newError;
+        // Lowest error wins; ties go to the earliest trial, as in a sequential loop
+        auto error = 9999999;
+        int best = -1;
+        for (int i = 0; i < PIPELINE_ITERATIONS; ++i) {
+            auto &trial = trials[i];
+            std::ranges::move(trial.debugLayers, std::back_inserter(debugLayers));
+            std::ranges::move(trial.neighborCandidates, std::back_inserter(debugNeighborCandidates));
+            if (trial.error < error) {
+                error = trial.error;
+                best = i;
             }
         }
+        if (best < 0) return;
+        const PixelArtImage &bestCorrectedCanvas = trials[best].canvas;
 
-        auto detection = std::make_unique<BandingDetection>(canvas);
-        auto originalError = std::get<0>(detection->bandingDetection());
+        const int originalError = BandingDetection::detect(canvas).error;
 
         errorImprovement = originalError - error;
 
@@ -95,7 +186,38 @@ public:
         errorImprovement = 0;
     }
 
+    /**
+     * How trials look for a low-banding canvas.
+     * RandomRestarts builds each trial once, independently; Annealing runs a local search chain per trial,
+     * mutating one layer's erosion or expansion at a time and re-detecting only what the mutation changed.
+     */
+    enum class SearchMode {
+        RandomRestarts,
+        Annealing
+    };
+
+    void setSearchMode(SearchMode mode) { searchMode = mode; }
+
+    /**
+     * @param milliseconds the CPU time shared by all annealing chains of a run; each chain measures its share
+     *        on its own thread's CPU clock, so the wall time of a run depends on how many cores run chains
+     */
+    void setSearchBudget(int milliseconds) { SEARCH_BUDGET_MS = milliseconds; }
+
     void renderUI() override {
+        const char *searchModes[] = {"Random Restarts", "Annealing"};
+        int searchModeIndex = static_cast<int>(searchMode);
+        ImGui::Text("Search Mode");
+        ImGui::SetNextItemWidth(-FLT_MIN);
+        if (ImGui::Combo("##Search Mode", &searchModeIndex, searchModes, IM_ARRAYSIZE(searchModes)))
+            searchMode = static_cast<SearchMode>(searchModeIndex);
+
+        if (searchMode == SearchMode::Annealing) {
+            ImGui::Text("Search Budget (CPU ms)");
+            ImGui::SetNextItemWidth(-FLT_MIN);
+            ImGui::DragInt("##Search Budget", &SEARCH_BUDGET_MS, 10.0f, 10, 60000);
+        }
+
         ImGui::Text("Pipeline Iterations");
         ImGui::SetNextItemWidth(-FLT_MIN);
         ImGui::DragInt("##Pipeline Iterations", &PIPELINE_ITERATIONS, 1.0f, 1, 10);
@@ -174,7 +296,6 @@ public:
     }
 
 private:
-    PixelArtImage originalCanvas = PixelArtImage(0, 0);
     std::default_random_engine generator{42}; // Seed for reproducibility
     std::vector<cv::Mat> debugLayers;
     bool showDebug = false;
@@ -188,130 +309,510 @@ private:
     float LINEAR_EROSION_FACTOR = 1.0f; // Default factor
     // int EXPANSION_ITERATIONS = 1;
     float PROB_ADD_CANDIDATE_PIXEL = 0.3f;
+    static constexpr int SUBJECT_THRESHOLD = 250; // tolerance for "near-white"
     int PIPELINE_ITERATIONS = 10;
+    SearchMode searchMode = SearchMode::RandomRestarts;
+    int SEARCH_BUDGET_MS = 2000; // annealing: CPU time shared by all chains
     bool PRESERVE_OUTLINE = true;
 
-    void constructCorrectedCanvas(int width, int height, std::vector<std::pair<Color, cv::Mat> > layers,
-                                  PixelArtImage &correctedCanvas) {
-        correctedCanvas.fill({255, 255, 255});
-
-        int startingLayer = 1;
-        if (PRESERVE_OUTLINE) {
-            startingLayer = 2;
-        } else {
-            startingLayer = 1;
+    /**
+     * @struct TrialPlan
+     * What every trial of a run starts from. None of it depends on a trial's random numbers, so it is
+     * built once per run.
+     */
+    struct TrialPlan {
+        PixelArtImage base{0, 0}; // white, then the outline if preserved and the first layer; trials copy it
+        int startingLayer = 1; // the first shaded layer
+        int finalLayer = 0; // the last shaded layer
+        std::optional<cv::Mat> drawnPathMask; // the filled drawn path, drawn over every trial as-is
+        std::vector<cv::Mat> translated; // each shaded layer moved towards the generator, from startingLayer
+        std::vector<cv::Rect> reach; // layerReach of each moved layer
+
+        [[nodiscard]] size_t memoryBytes() const {
+            size_t bytes = MemoryStats::total(base.getMemoryUsage()) + MemoryStats::vectorBytes(translated) +
+                           MemoryStats::vectorBytes(reach);
+            if (drawnPathMask.has_value()) bytes += MemoryStats::matBytes(*drawnPathMask);
+            for (const auto &mask: translated) bytes += MemoryStats::matBytes(mask);
+            return bytes;
         }
+    };
+
+    /**
+     * Builds the invariants of a run: the base canvas, the generator or drawn path and the moved layers.
+     * @param width of the canvas
+     * @param height of the canvas
+     * @param layers the filled layer masks
+     * @return the plan the trials share
+     */
+    [[nodiscard]] TrialPlan planTrials(int width, int height,
+                                       const std::vector<std::pair<Color, cv::Mat> > &layers) const {
+        PF_PROFILE_SCOPE("planTrials");
+        TrialPlan plan;
+        plan.startingLayer = PRESERVE_OUTLINE ? 2 : 1;
 
         // Fill subject outline and first layer
-        for (size_t i = 0; i < startingLayer; ++i) {
+        plan.base = PixelArtImage(width, height);
+        plan.base.fill({255, 255, 255});
+        for (int i = 0; i < plan.startingLayer; ++i) {
             auto &[color, currentMask] = layers[i];
             for (int y = 0; y < height; ++y)
                 for (int x = 0; x < width; ++x)
                     if (currentMask.at<uchar>(y, x))
-                        correctedCanvas.setPixel({x, y}, color);
+                        plan.base.setPixel({x, y}, color);
         }
 
         std::optional<Pixel> generator = std::nullopt;
-        std::optional<cv::Mat> drawnPathMask = std::nullopt;
+        locateGenerator(width, height, generator, plan.drawnPathMask);
+        plan.finalLayer = static_cast<int>(layers.size()) - (plan.drawnPathMask.has_value() ? 2 : 1);
+
+        for (int i = plan.startingLayer; i <= plan.finalLayer; ++i) {
+            plan.translated.push_back(translateLayer(layers, i, generator));
+            plan.reach.push_back(layerReach(plan.translated.back()));
+        }
+        return plan;
+    }
+
+    void constructCorrectedCanvas(const TrialPlan &plan, const std::vector<std::pair<Color, cv::Mat> > &layers,
+                                  PixelArtImage &correctedCanvas, std::default_random_engine &random,
+                                  std::vector<cv::Mat> &trialDebugLayers,
+                                  std::vector<std::unordered_set<std::pair<int, int> > > &trialNeighborCandidates) const {
+        PF_PROFILE_SCOPE("constructCorrectedCanvas");
+        correctedCanvas = plan.base;
+        const cv::Mat &clip = layers[plan.startingLayer - 1].second;
+
+        for (int i = plan.startingLayer; i <= plan.finalLayer; ++i) {
+            const Color color = layers[i].first;
+            const cv::Mat &translatedMask = plan.translated[i - plan.startingLayer];
+
+            std::unordered_set<std::pair<int, int> > neighbors;
+            const LayerShape shape = [&] {
+                PF_PROFILE_SCOPE("shapeLayer");
+                return shapeLayer(translatedMask, plan.reach[i - plan.startingLayer], erosionIterations(i), random,
+                                  neighbors);
+            }();
+            trialDebugLayers.push_back(translatedMask);
+            trialNeighborCandidates.push_back(std::move(neighbors));
+
+            PF_PROFILE_SCOPE("composite");
+            for (int y = 0; y < shape.region.height; ++y) {
+                const uchar *covered = shape.mask.ptr<uchar>(y);
+                for (int x = 0; x < shape.region.width; ++x)
+                    if (covered[x] && clip.at<uchar>(shape.region.y + y, shape.region.x + x))
+                        correctedCanvas.setPixel({shape.region.x + x, shape.region.y + y}, color);
+            }
+        }
+
+        // If a drawn path mask was constructed, add it as the final layer as-is
+        if (plan.drawnPathMask.has_value()) {
+            auto &mask = plan.drawnPathMask.value();
+            Color lastColor = layers.back().first; // Use the last layer color for consistency
+            for (int y = 0; y < mask.rows; ++y)
+                for (int x = 0; x < mask.cols; ++x)
+                    if (mask.at<uchar>(y, x))
+                        correctedCanvas.setPixel({x, y}, lastColor);
+        }
+    }
 
+    /**
+     * Finds where the shading converges: the generator pixel if one is set, else the center of the drawn path.
+     * @param width of the canvas
+     * @param height of the canvas
+     * @param generator receives the generator, if any
+     * @param drawnPathMask receives the filled drawn path, if there is one and no generator
+     */
+    void locateGenerator(int width, int height, std::optional<Pixel> &generator,
+                         std::optional<cv::Mat> &drawnPathMask) const {
         // First try to get the generator pixel
         if (auto dp = getPixelArtImage().getGenerator(); dp.has_value()) {
             generator = dp;
-        } else {
-            const auto &drawnPath = getPixelArtImage().getDrawnPath();
-            if (!drawnPath.empty()) {
-                std::vector<cv::Point> contour;
-                for (const Pixel &p: drawnPath)
-                    contour.emplace_back(p.pos.x, p.pos.y);
-
-                cv::Mat mask = cv::Mat::zeros(height, width, CV_8UC1);
-                std::vector<std::vector<cv::Point> > contours = {contour};
-                cv::drawContours(mask, contours, 0, 255, cv::FILLED);
-
-                // Compute the center of mass
-                cv::Moments m = cv::moments(mask, true);
-                if (m.m00 != 0.0) {
-                    int cx = static_cast<int>(m.m10 / m.m00);
-                    int cy = static_cast<int>(m.m01 / m.m00);
-                    generator = Pixel{{0, 0, 0}, {cx, cy}};
-                }
+            return;
+        }
 
-                drawnPathMask = mask;
-            }
+        const auto &drawnPath = getPixelArtImage().getDrawnPath();
+        if (drawnPath.empty()) return;
+
+        std::vector<cv::Point> contour;
+        for (const Pixel &p: drawnPath)
+            contour.emplace_back(p.pos.x, p.pos.y);
+
+        cv::Mat mask = cv::Mat::zeros(height, width, CV_8UC1);
+        std::vector<std::vector<cv::Point> > contours = {contour};
+        cv::drawContours(mask, contours, 0, 255, cv::FILLED);
+
+        // Compute the center of mass
+        cv::Moments m = cv::moments(mask, true);
+        if (m.m00 != 0.0) {
+            int cx = static_cast<int>(m.m10 / m.m00);
+            int cy = static_cast<int>(m.m01 / m.m00);
+            generator = Pixel{{0, 0, 0}, {cx, cy}};
         }
 
-        int finalLayer = 0;
-        if (drawnPathMask.has_value()) {
-            finalLayer = layers.size() - 2;
-        } else {
-            finalLayer = layers.size() - 1;
+        drawnPathMask = mask;
+    }
+
+    /**
+     * Moves a layer towards the generator; layers further up the stack move further.
+     * @param layers the filled layer masks
+     * @param i the layer to move
+     * @param generator where the shading converges, or nullopt to leave the layer in place
+     * @return the moved mask
+     */
+    static cv::Mat translateLayer(const std::vector<std::pair<Color, cv::Mat> > &layers, size_t i,
+                                  const std::optional<Pixel> &generator) {
+        const cv::Mat &currentMask = layers[i].second;
+        if (!generator.has_value()) return currentMask;
+
+        const int width = currentMask.cols;
+        const int height = currentMask.rows;
+        cv::Mat translatedMask = cv::Mat::zeros(height, width, CV_8UC1);
+
+        int minX = width, minY = height, maxX = 0, maxY = 0;
+        for (int y = 0; y < height; ++y)
+            for (int x = 0; x < width; ++x)
+                if (currentMask.at<uchar>(y, x)) {
+                    minX = std::min(minX, x);
+                    minY = std::min(minY, y);
+                    maxX = std::max(maxX, x);
+                    maxY = std::max(maxY, y);
+                }
+
+        int centerX = (minX + maxX) / 2;
+        int centerY = (minY + maxY) / 2;
+
+        int dx = generator->pos.x - centerX;
+        int dy = generator->pos.y - centerY;
+
+        for (int y = 0; y < height; ++y)
+            for (int x = 0; x < width; ++x)
+                if (currentMask.at<uchar>(y, x)) {
+                    float attenuation = 1.0f / (static_cast<float>(layers.size()) - i);
+                    int newX = x + dx * attenuation;
+                    int newY = y + dy * attenuation;
+                    if (newX >= 0 && newX < width && newY >= 0 && newY < height)
+                        translatedMask.at<uchar>(newY, newX) = 255;
+                }
+        return translatedMask;
+    }
+
+    /**
+     * @param i a layer index
+     * @return how many times the layer is eroded under the current erosion mode
+     */
+    [[nodiscard]] int erosionIterations(size_t i) const {
+        return erosionMode == 0 ? 1 : static_cast<int>(LINEAR_EROSION_FACTOR * i);
+    }
+
+    /**
+     * @struct LayerShape
+     * The final shape of a moved layer, stored only over the region the layer can reach.
+     */
+    struct LayerShape {
+        cv::Rect region;
+        cv::Mat mask; // region-sized, 255 where the layer covers the canvas
+
+        /**
+         * @param x a canvas column
+         * @param y a canvas row
+         * @return true if the layer covers the pixel
+         */
+        [[nodiscard]] bool covers(int x, int y) const {
+            return x >= region.x && x < region.x + region.width && y >= region.y && y < region.y + region.height &&
+                   mask.at<uchar>(y - region.y, x - region.x);
         }
+    };
+
+    /**
+     * Starts an independent engine from a seed drawn from another one. The default engine is a linear
+     * congruential generator, so one seeded directly with a value it produced would replay its parent's
+     * stream shifted by one step; the seed sequence scrambles the value first.
+     * @param seed drawn from the parent engine
+     * @return the new engine
+     */
+    static std::default_random_engine spawnEngine(std::default_random_engine::result_type seed) {
+        std::seed_seq sequence{seed};
+        return std::default_random_engine(sequence);
+    }
 
-        for (size_t i = startingLayer; i <= finalLayer; ++i) {
-            auto &[color, currentMask] = layers[i];
-            cv::Mat translatedMask = cv::Mat::zeros(height, width, CV_8UC1);
-
-            if (generator.has_value()) {
-                int minX = width, minY = height, maxX = 0, maxY = 0;
-                for (int y = 0; y < height; ++y)
-                    for (int x = 0; x < width; ++x)
-                        if (currentMask.at<uchar>(y, x)) {
-                            minX = std::min(minX, x);
-                            minY = std::min(minY, y);
-                            maxX = std::max(maxX, x);
-                            maxY = std::max(maxY, y);
-                        }
-
-                int centerX = (minX + maxX) / 2;
-                int centerY = (minY + maxY) / 2;
-
-                int dx = generator->pos.x - centerX;
-                int dy = generator->pos.y - centerY;
-
-                for (int y = 0; y < height; ++y)
-                    for (int x = 0; x < width; ++x)
-                        if (currentMask.at<uchar>(y, x)) {
-                            float attenuation = 1.0f / (static_cast<float>(layers.size()) - i);
-                            int newX = x + dx * attenuation;
-                            int newY = y + dy * attenuation;
-                            if (newX >= 0 && newX < width && newY >= 0 && newY < height)
-                                translatedMask.at<uchar>(newY, newX) = 255;
-                        }
-            } else {
-                translatedMask = currentMask;
+    /**
+     * The pixels a moved layer can cover: shapeLayer's erosion only shrinks it, and its growth adds at most
+     * three pixels.
+     * @param translatedMask the moved layer
+     * @return its bounding box grown by three pixels and clipped to the canvas, empty if the layer is
+     */
+    static cv::Rect layerReach(const cv::Mat &translatedMask) {
+        const cv::Rect bounds = cv::boundingRect(translatedMask);
+        if (bounds.width == 0 || bounds.height == 0) return {};
+        return cv::Rect(bounds.x - 3, bounds.y - 3, bounds.width + 6, bounds.height + 6) &
+               cv::Rect(0, 0, translatedMask.cols, translatedMask.rows);
+    }
+
+    /**
+     * Erodes a moved layer, then grows it back: background pixels with exactly three of their eight
+     * neighbors in the eroded shape join it with probability PROB_ADD_CANDIDATE_PIXEL, the result is dilated
+     * by one pixel, and horizontal or vertical gaps between contour pixels are bridged.
+     *
+     * The stages are fused into one pass down the layer's reach. Each stage keeps a window of the last few
+     * rows it produced, lagging one row behind the stage it reads, so only the final shape is stored at the
+     * size of the reach. Candidates are drawn in row-major order.
+     * @param translatedMask the moved layer
+     * @param region the layer's reach, see layerReach
+     * @param erosion erosion iterations of a 3x3 kernel
+     * @param random decides which candidate pixels are added
+     * @param neighbors receives the contour pixels and the bridged gaps
+     * @return the layer's final shape
+     */
+    LayerShape shapeLayer(const cv::Mat &translatedMask, const cv::Rect &region, int erosion,
+                          std::default_random_engine &random,
+                          std::unordered_set<std::pair<int, int> > &neighbors) const {
+        LayerShape shape{region, cv::Mat::zeros(region.height, region.width, CV_8UC1)};
+        if (region.width <= 0 || region.height <= 0) return shape;
+
+        const int width = translatedMask.cols, height = translatedMask.rows;
+        const int x0 = region.x, y0 = region.y, y1 = region.y + region.height, regionWidth = region.width;
+        const int k = std::max(erosion, 0);
+
+        // The rows of a stage outside the reach are background
+        constexpr int WINDOW = 4;
+        std::vector<uchar> eroded(WINDOW * regionWidth), grown(WINDOW * regionWidth),
+                dilated(WINDOW * regionWidth), contour(WINDOW * regionWidth);
+        const std::vector<uchar> background(regionWidth + 2, 0);
+        auto rowOf = [&](std::vector<uchar> &stage, int y) { return stage.data() + y % WINDOW * regionWidth; };
+        auto read = [&](const std::vector<uchar> &stage, int y) {
+            return y < y0 || y >= y1 ? background.data() : stage.data() + y % WINDOW * regionWidth;
+        };
+        auto at = [&](const uchar *row, int x) -> uchar { return x < 0 || x >= regionWidth ? 0 : row[x]; };
+
+        // Erosion: a pixel survives if the (2k+1)x(2k+1) window around it, clipped to the canvas, holds no
+        // background. zeros counts the background pixels of each column over the window's rows.
+        const int columnLow = std::max(x0 - k, 0), columnHigh = std::min(x0 + regionWidth + k, width);
+        std::vector<int> zeros(columnHigh - columnLow, 0), zerosPrefix(columnHigh - columnLow + 1, 0);
+        auto countRow = [&](int y, int sign) {
+            if (y < 0 || y >= height) return;
+            const uchar *source = translatedMask.ptr<uchar>(y);
+            for (int x = columnLow; x < columnHigh; ++x)
+                if (!source[x]) zeros[x - columnLow] += sign;
+        };
+        for (int y = y0 - k; y < y0 + k; ++y) countRow(y, 1);
+
+        auto erodeRow = [&](int y) {
+            countRow(y + k, 1);
+            for (size_t i = 0; i < zeros.size(); ++i) zerosPrefix[i + 1] = zerosPrefix[i] + zeros[i];
+            uchar *out = rowOf(eroded, y);
+            for (int x = 0; x < regionWidth; ++x) {
+                const int low = std::max(x0 + x - k, 0) - columnLow;
+                const int high = std::min(x0 + x + k, width - 1) - columnLow;
+                out[x] = zerosPrefix[high + 1] == zerosPrefix[low] ? 255 : 0;
+            }
+            countRow(y - k, -1);
+        };
+
+        std::uniform_real_distribution dist(0.0, 1.0);
+        auto growRow = [&](int y) {
+            const uchar *above = read(eroded, y - 1), *row = read(eroded, y), *below = read(eroded, y + 1);
+            uchar *out = rowOf(grown, y);
+            for (int x = 0; x < regionWidth; ++x) {
+                out[x] = row[x];
+                if (row[x]) continue;
+                int count = (at(row, x - 1) != 0) + (at(row, x + 1) != 0);
+                for (const uchar *r: {above, below})
+                    count += (at(r, x - 1) != 0) + (r[x] != 0) + (at(r, x + 1) != 0);
+                if (count == 3 && dist(random) < PROB_ADD_CANDIDATE_PIXEL) out[x] = 255;
             }
+        };
 
-            cv::Mat modified;
-            cv::Mat kernel = cv::Mat::ones(3, 3, CV_8UC1);
-            if (erosionMode == 0) {
-                cv::erode(translatedMask, modified, kernel, cv::Point(-1, -1), 1);
-            } else {
-                cv::erode(translatedMask, modified, kernel, cv::Point(-1, -1),
-                          static_cast<int>(LINEAR_EROSION_FACTOR * i));
+        auto dilateRow = [&](int y) {
+            const uchar *rows[] = {read(grown, y - 1), read(grown, y), read(grown, y + 1)};
+            uchar *out = rowOf(dilated, y);
+            uchar *result = shape.mask.ptr<uchar>(y - y0);
+            for (int x = 0; x < regionWidth; ++x) {
+                uchar value = 0;
+                for (const uchar *r: rows) value |= at(r, x - 1) | r[x] | at(r, x + 1);
+                out[x] = result[x] = value;
             }
+        };
 
-            debugLayers.push_back(translatedMask);
-            std::unordered_set<std::pair<int, int> > neighbors;
-            expandShape(modified, &neighbors, 1);
-            debugNeighborCandidates.push_back(std::move(neighbors));
+        // Contour pixels are covered pixels away from the canvas border with a 4-neighbor in the background
+        auto contourRow = [&](int y) {
+            const uchar *above = read(dilated, y - 1), *row = read(dilated, y), *below = read(dilated, y + 1);
+            uchar *out = rowOf(contour, y);
+            for (int x = 0; x < regionWidth; ++x) {
+                const int canvasX = x0 + x;
+                out[x] = row[x] && canvasX >= 1 && canvasX < width - 1 && y >= 1 && y < height - 1 &&
+                         (!above[x] || !below[x] || !at(row, x - 1) || !at(row, x + 1));
+                if (out[x]) neighbors.insert({canvasX, y});
+            }
+        };
 
-            for (int y = 0; y < height; ++y)
-                for (int x = 0; x < width; ++x)
-                    if (modified.at<uchar>(y, x) && layers[startingLayer - 1].second.at<uchar>(y, x))
-                        correctedCanvas.setPixel({x, y}, color);
+        // A run of background pixels next to the contour, bounded by contour pixels on both ends along a row or a
+        // column, is a gap and gets filled. openColumns holds, per column, the row of the last contour pixel
+        // followed only by such pixels, or -1.
+        std::vector<int> openColumns(regionWidth, -1);
+        auto bridge = [&](int x, int y) {
+            shape.mask.at<uchar>(y - y0, x) = 255;
+            neighbors.insert({x0 + x, y});
+        };
+        auto bridgeRow = [&](int y) {
+            const uchar *above = read(contour, y - 1), *row = read(contour, y), *below = read(contour, y + 1);
+            const uchar *covered = read(dilated, y);
+            int openRow = -1;
+            for (int x = 0; x < regionWidth; ++x) {
+                const bool neighbor = !covered[x] && (above[x] || below[x] || at(row, x - 1) || at(row, x + 1));
+                if (row[x]) {
+                    for (int gap = openRow + 1; openRow >= 0 && gap < x; ++gap) bridge(gap, y);
+                    for (int gap = openColumns[x] + 1; openColumns[x] >= 0 && gap < y; ++gap) bridge(x, gap);
+                    openRow = x;
+                    openColumns[x] = y;
+                } else if (!neighbor) {
+                    openRow = openColumns[x] = -1;
+                }
+            }
+        };
+
+        for (int y = y0; y < y1 + 4; ++y) {
+            if (y < y1) erodeRow(y);
+            if (y - 1 >= y0 && y - 1 < y1) growRow(y - 1);
+            if (y - 2 >= y0 && y - 2 < y1) dilateRow(y - 2);
+            if (y - 3 >= y0 && y - 3 < y1) contourRow(y - 3);
+            if (y - 4 >= y0 && y - 4 < y1) bridgeRow(y - 4);
         }
+        return shape;
+    }
 
-        // If a drawn path mask was constructed, add it as the final layer as-is
-        if (drawnPathMask.has_value()) {
-            auto &mask = drawnPathMask.value();
-            Color lastColor = layers.back().first; // Use the last layer color for consistency
+    /**
+     * One local search chain: starts from a corrected canvas like constructCorrectedCanvas, then mutates one
+     * layer's erosion or expansion seed at a time. A mutation is scored by recompositing and re-detecting only
+     * the rows and columns it changed, and kept by the Metropolis rule under a temperature that falls to zero
+     * at the deadline. The canvas ends as the best state seen.
+     * @param plan the invariants of the run
+     * @param layers the filled layer masks
+     * @param correctedCanvas receives the best canvas
+     * @param random seeds the chain
+     * @param budget the CPU time the chain may use, measured on the thread that runs it
+     * @param trialDebugLayers receives the moved layer masks
+     * @param trialNeighborCandidates receives shapeLayer's neighbors of the best state
+     * @return the banding error of the best canvas
+     */
+    int annealCorrectedCanvas(const TrialPlan &plan, const std::vector<std::pair<Color, cv::Mat> > &layers,
+                              PixelArtImage &correctedCanvas, std::default_random_engine &random,
+                              ThreadCpuClock::duration budget, std::vector<cv::Mat> &trialDebugLayers,
+                              std::vector<std::unordered_set<std::pair<int, int> > > &trialNeighborCandidates) const {
+        // One zone per chain: the steps below run thousands of times, too often for zones of their own
+        PF_PROFILE_SCOPE("annealCorrectedCanvas");
+        const auto start = ThreadCpuClock::now();
+        const int width = plan.base.getWidth(), height = plan.base.getHeight();
+        const int startingLayer = plan.startingLayer;
+        const std::optional<cv::Mat> &drawnPathMask = plan.drawnPathMask;
+        const cv::Mat &clip = layers[startingLayer - 1].second;
+
+        // The decisions of every shaded layer; index 0 is layer startingLayer
+        struct Decision {
+            int erosion;
+            std::default_random_engine::result_type seed;
+        };
+        const int shadedLayers = static_cast<int>(plan.translated.size());
+        std::vector<Decision> decisions(shadedLayers);
+        std::vector<LayerShape> shapes(shadedLayers);
+        const std::vector<cv::Rect> &reach = plan.reach;
+        trialDebugLayers = plan.translated;
+        trialNeighborCandidates.assign(shadedLayers, {});
+
+        auto shape = [&](int k, const Decision &decision, std::unordered_set<std::pair<int, int> > &neighbors) {
+            std::default_random_engine layerRandom = spawnEngine(decision.seed);
+            return shapeLayer(plan.translated[k], reach[k], decision.erosion, layerRandom, neighbors);
+        };
+
+        for (int k = 0; k < shadedLayers; ++k) {
+            decisions[k] = {erosionIterations(startingLayer + k), random()};
+            shapes[k] = shape(k, decisions[k], trialNeighborCandidates[k]);
+        }
+
+        // The color of a pixel is the one of the topmost layer covering it
+        auto colorAt = [&](int x, int y) -> Color {
+            if (drawnPathMask.has_value() && drawnPathMask->at<uchar>(y, x)) return layers.back().first;
+            if (clip.at<uchar>(y, x))
+                for (int k = shadedLayers - 1; k >= 0; --k)
+                    if (shapes[k].covers(x, y)) return layers[startingLayer + k].first;
+            return plan.base.getPixel({x, y}).color;
+        };
+
+        auto composite = [&] {
+            correctedCanvas = plan.base;
             for (int y = 0; y < height; ++y)
                 for (int x = 0; x < width; ++x)
-                    if (mask.at<uchar>(y, x))
-                        correctedCanvas.setPixel({x, y}, lastColor);
+                    correctedCanvas.setPixel({x, y}, colorAt(x, y));
+        };
+        composite();
+
+        IncrementalBandingDetector detector;
+        int current = detector.update(correctedCanvas, nullptr).error;
+        if (current < 0) return BandingDetection::detect(correctedCanvas).error; // nothing to rescan incrementally
+        if (shadedLayers == 0) return current;
+        int best = current;
+        std::vector<Decision> bestDecisions = decisions;
+
+        std::uniform_int_distribution<int> pickLayer(0, shadedLayers - 1);
+        std::uniform_real_distribution<double> unit(0.0, 1.0);
+        FrameSequence::FrameDiff diff;
+        std::vector<Pixel> undo;
+
+        while (!isCancelled()) {
+            const auto elapsed = ThreadCpuClock::now() - start;
+            if (elapsed >= budget) break;
+            const double temperature = 1.0 - std::chrono::duration<double>(elapsed) / budget;
+
+            const int k = pickLayer(random);
+            Decision decision = decisions[k];
+            if (unit(random) < 0.5)
+                decision.seed = random();
+            else
+                decision.erosion = std::max(0, decision.erosion + (unit(random) < 0.5 ? -1 : 1));
+
+            std::unordered_set<std::pair<int, int> > neighbors;
+            LayerShape previousShape = shapes[k];
+            shapes[k] = shape(k, decision, neighbors);
+
+            // Recomposite the pixels whose coverage changed
+            const cv::Rect &region = reach[k];
+            diff.changedPixels = 0;
+            diff.rows.assign(height, false);
+            diff.columns.assign(width, false);
+            undo.clear();
+            for (int y = region.y; y < region.y + region.height; ++y)
+                for (int x = region.x; x < region.x + region.width; ++x) {
+                    if (shapes[k].covers(x, y) == previousShape.covers(x, y)) continue;
+                    const Pixel before = correctedCanvas.getPixel({x, y});
+                    const Color color = colorAt(x, y);
+                    if (color == before.color) continue;
+                    undo.push_back(before);
+                    correctedCanvas.setPixel({x, y}, color);
+                    diff.rows[y] = diff.columns[x] = true;
+                    ++diff.changedPixels;
+                }
+
+            const int candidate = diff.empty() ? current : detector.update(correctedCanvas, &diff).error;
+            const int delta = candidate - current;
+            if (delta <= 0 || unit(random) < std::exp(-delta / std::max(temperature, 0.05))) {
+                decisions[k] = decision;
+                current = candidate;
+                if (current < best) {
+                    best = current;
+                    bestDecisions = decisions;
+                }
+            } else {
+                shapes[k] = previousShape;
+                for (const Pixel &pixel: undo) correctedCanvas.setPixel(pixel.pos, pixel.color);
+                detector.update(correctedCanvas, &diff);
+            }
         }
-    }
 
+        // Rebuild the best state; the shapes are reproducible from their decisions
+        for (int k = 0; k < shadedLayers; ++k) {
+            trialNeighborCandidates[k].clear();
+            shapes[k] = shape(k, bestDecisions[k], trialNeighborCandidates[k]);
+        }
+        composite();
+        return best;
+    }
 
     static bool arePointsCollinear(const std::vector<cv::Point> &pts) {
         if (pts.size() < 3) return true;
@@ -329,6 +830,7 @@ private:
 
     static void computeConcaveHull(const std::vector<cv::Point> &points, std::vector<std::vector<cv::Point> > &contours,
                                    double chi = 0.1) {
+        PF_PROFILE_SCOPE("computeConcaveHull");
         // Remove duplicates
         std::vector<cv::Point> pts(points.begin(), points.end());
 
@@ -380,226 +882,176 @@ private:
     }
 
 
-    std::vector<std::pair<Color, cv::Mat> > extractLayers(const PixelArtImage &canvas) {
-        int width = canvas.getWidth();
-        int height = canvas.getHeight();
-
-        cv::Mat subjectMask = extractSubjectMask(canvas);
-
-        std::unordered_map<Color, std::vector<cv::Point> > colorPixels;
-        for (int y = 0; y < height; ++y)
-            for (int x = 0; x < width; ++x) {
-                if (subjectMask.at<uchar>(y, x) == 0) continue;
-                Color color = canvas.getPixel({x, y}).color;
-                colorPixels[color].emplace_back(x, y);
-            }
-
-        // Move color pixels to vector and sort by brightness before creating masks
-        std::vector<std::pair<Color, std::vector<cv::Point> > > sortedColorPixels(
-            colorPixels.begin(), colorPixels.end());
-
-        std::ranges::sort(sortedColorPixels, [&](const auto &a, const auto &b) {
-            auto brightnessA = 0.2126f * a.first.r + 0.7152f * a.first.g + 0.0722f * a.first.b;
-            auto brightnessB = 0.2126f * b.first.r + 0.7152f * b.first.g + 0.0722f * b.first.b;
-            return brightnessA < brightnessB;
-        });
-
-        std::vector<std::pair<Color, cv::Mat> > layers;
-
-        for (size_t i = 0; i < sortedColorPixels.size(); ++i) {
-            const auto &[color, points] = sortedColorPixels[i];
-
-            cv::Mat mask = cv::Mat::zeros(height, width, CV_8UC1);
-            for (const auto &pt: points)
-                mask.at<uchar>(pt.y, pt.x) = 255;
-
-            int firstLayers = PRESERVE_OUTLINE ? 2 : 1;
-            std::vector<std::vector<cv::Point> > contours;
-            cv::Mat filledMask = cv::Mat::zeros(height, width, CV_8UC1);
-            if (i < firstLayers) {
-                // Keep the original mask for the first two layers, and fill it
-                cv::findContours(mask.clone(), contours, cv::RETR_EXTERNAL, cv::CHAIN_APPROX_SIMPLE);
-            } else {
-                // Compute filled mask using concave hull
-                computeConcaveHull(points, contours, 0.1);
-            }
-
-            cv::drawContours(filledMask, contours, -1, 255, cv::FILLED);
-            layers.emplace_back(color, filledMask);
-        }
-
-        return layers;
+    static size_t neighborCandidatesBytes(const std::vector<std::unordered_set<std::pair<int, int> > > &sets) {
+        // Hash nodes hold the entry and a next pointer; buckets are one pointer each
+        size_t bytes = MemoryStats::vectorBytes(sets);
+        for (const auto &set: sets)
+            bytes += set.size() * (sizeof(std::pair<int, int>) + sizeof(void *)) + set.bucket_count() * sizeof(void *);
+        return bytes;
     }
 
-    void expandShape(cv::Mat &input_shape, std::unordered_set<std::pair<int, int> > *out_candidate_neighbors = nullptr,
-                     int iterations = 1) {
-        if (iterations == 0) return;
-
-        std::vector<std::pair<int, int> > neighbors_8 = {
-            {-1, -1}, {-1, 0}, {-1, 1},
-            {0, -1}, {0, 1},
-            {1, -1}, {1, 0}, {1, 1}
+    /**
+     * The subject's colors as layers, darkest first, gathered in one pass over the canvas.
+     * Layer masks are not stored; they are cut from the label plane when needed.
+     */
+    struct LayerTable {
+        struct Layer {
+            Color color;
+            cv::Rect bounds;               // bounding box of the layer's pixels
+            std::vector<cv::Point> points; // the layer's pixels, row by row
         };
 
-        std::unordered_set<std::pair<int, int> > shape;
-
-        for (int y = 0; y < input_shape.rows; ++y)
-            for (int x = 0; x < input_shape.cols; ++x)
-                if (input_shape.at<uchar>(y, x) > 0)
-                    shape.emplace(x, y);
-
-        std::unordered_map<std::pair<int, int>, int> candidate_counts;
-
-        for (const auto &pt: shape) {
-            for (const auto &[dx, dy]: neighbors_8) {
-                auto neighbor = std::make_pair(pt.first + dx, pt.second + dy);
-                if (!shape.contains(neighbor))
-                    candidate_counts[neighbor]++;
+        int width = 0;
+        int height = 0;
+        std::vector<int> labels; // [y * width + x]: layer of the pixel, -1 outside the subject
+        std::vector<Layer> layers;
+
+        /**
+         * @param layer a layer index
+         * @param region the part of the canvas to cover
+         * @return a CV_8UC1 mask of the region, 255 on the layer's pixels
+         */
+        [[nodiscard]] cv::Mat mask(int layer, const cv::Rect &region) const {
+            cv::Mat mask(region.size(), CV_8UC1);
+            for (int y = 0; y < region.height; ++y) {
+                const int *row = labels.data() + static_cast<size_t>(region.y + y) * width + region.x;
+                auto *out = mask.ptr<uchar>(y);
+                for (int x = 0; x < region.width; ++x) out[x] = row[x] == layer ? 255 : 0;
             }
+            return mask;
         }
 
+        [[nodiscard]] size_t memoryBytes() const {
+            size_t bytes = MemoryStats::vectorBytes(labels) + MemoryStats::vectorBytes(layers);
+            for (const auto &layer: layers) bytes += MemoryStats::vectorBytes(layer.points);
+            return bytes;
+        }
+    };
 
-        cv::Mat dilated;
-        for (int i = 0; i < iterations; ++i) {
-            // Recompute candidate pixels
-            candidate_counts.clear();
-            for (const auto &pt: shape) {
-                for (const auto &[dx, dy]: neighbors_8) {
-                    auto neighbor = std::make_pair(pt.first + dx, pt.second + dy);
-                    if (!shape.contains(neighbor))
-                        candidate_counts[neighbor]++;
-                }
-            }
-
-            // First pass: probabilistic addition
-            std::unordered_set<std::pair<int, int> > addedPixels;
-            std::uniform_real_distribution dist(0.0, 1.0);
+    static float luminance(const Color &color) {
+        return 0.2126f * color.r + 0.7152f * color.g + 0.0722f * color.b;
+    }
 
-            for (const auto &[pt, count]: candidate_counts) {
-                if (count == 3 && dist(generator) < PROB_ADD_CANDIDATE_PIXEL) {
-                    // Add the pixel
-                    addedPixels.insert(pt);
-                    shape.insert(pt);
+    /**
+     * Splits the subject into one layer per color in a single pass: every subject pixel is labeled with
+     * its layer, and the layer's bounding box and pixel list grow as it is visited.
+     * @param canvas the image to split
+     * @return the layers, darkest first; ties keep palette order
+     */
+    static LayerTable extractLayers(const PixelArtImage &canvas) {
+        PF_PROFILE_SCOPE("extractLayers");
+        LayerTable table;
+        table.width = canvas.getWidth();
+        table.height = canvas.getHeight();
+        table.labels.assign(static_cast<size_t>(table.width) * table.height, -1);
+
+        auto addPixel = [&](int layerIndex, int x, int y) {
+            table.labels[static_cast<size_t>(y) * table.width + x] = layerIndex;
+            auto &layer = table.layers[layerIndex];
+            cv::Rect &bounds = layer.bounds;
+            if (layer.points.empty()) {
+                bounds = cv::Rect(x, y, 1, 1);
+            } else {
+                // Rows are visited top to bottom, so only the left and right edges can move back
+                if (x < bounds.x) {
+                    bounds.width += bounds.x - x;
+                    bounds.x = x;
                 }
+                bounds.width = std::max(bounds.width, x - bounds.x + 1);
+                bounds.height = y - bounds.y + 1;
             }
+            layer.points.emplace_back(x, y);
+        };
 
-            // Convert shape back to binary image
-            cv::Mat temp(input_shape.size(), CV_8UC1, cv::Scalar(0));
-            for (const auto &[x, y]: shape) {
-                if (x >= 0 && x < input_shape.cols && y >= 0 && y < input_shape.rows)
-                    temp.at<uchar>(y, x) = 255;
+        const PaletteIndex &paletteIndex = canvas.getPaletteIndex();
+        if (paletteIndex.isValid()) {
+            // The color -> layer table is sorted before the pass, so labels are final when written
+            const auto &palette = paletteIndex.getPalette();
+            std::vector<int> subjectEntries;
+            for (int id = 0; id < static_cast<int>(palette.size()); ++id)
+                if (PixelArtImage::isSubjectColor(palette[id], SUBJECT_THRESHOLD)) subjectEntries.push_back(id);
+            std::ranges::stable_sort(subjectEntries, [&](int a, int b) {
+                return luminance(palette[a]) < luminance(palette[b]);
+            });
+
+            std::vector<int> entryLayers(palette.size(), -1);
+            for (int id: subjectEntries) {
+                entryLayers[id] = static_cast<int>(table.layers.size());
+                table.layers.push_back({palette[id], {}, {}});
             }
 
-            // Second pass: apply a dilation to get back to the original size
-            cv::Mat kernel = cv::getStructuringElement(cv::MORPH_RECT, cv::Size(3, 3));
-            cv::dilate(temp, dilated, kernel, cv::Point(-1, -1), 1);
-
-
-            // Third pass: fill in gaps in the contour, to remove lone pixels
-
-            // Extract contour and neighbors of "dilated"
-            std::vector<std::pair<int, int> > neighbors_4 = {
-                {-1, 0},
-                {0, -1}, {0, 1},
-                {1, 0},
-            };
-
-            std::set<std::pair<int, int> > contour;
-            std::set<std::pair<int, int> > neighbors;
-
-            for (int y = 1; y < dilated.rows - 1; ++y) {
-                for (int x = 1; x < dilated.cols - 1; ++x) {
-                    if (dilated.at<uchar>(y, x) > 0) {
-                        for (const auto &[dx, dy]: neighbors_4) {
-                            if (dilated.at<uchar>(y + dy, x + dx) == 0) {
-                                contour.insert(std::pair(x, y));
-                                neighbors.insert(std::pair(x + dx, y + dy));
-                            }
-                        }
-                    }
+            for (int y = 0; y < table.height; ++y)
+                for (int x = 0; x < table.width; ++x) {
+                    const int layer = entryLayers[paletteIndex.at(y * table.width + x)];
+                    if (layer >= 0) addPixel(layer, x, y);
                 }
-            }
-
-
-            // Iterate through the contour
-            // For every pixel on the contour, check which directions are free: in other words
-            // check which of the neighbors_4 are not part of the contour as well
-            // If such pixels are found (say we found one above), iterate through each, doing the following:
-            // Try to add as many pixels in that direction as possible (so add as many pixels directly above)
-            // Until we "meet" another pixel from the contour
-            // And also while ensuring those added pixels are part of the neighbors set; once we find one not part
-            // of the neighbor set, you can directly "continue" the loop, not adding any of those pixels at all
-            // The point is that this technique would close "vertical/horizontal" gaps in contours
-            for (const auto &[x, y]: contour) {
-                for (const auto &[dx, dy]: neighbors_4) {
-                    int nx = x + dx;
-                    int ny = y + dy;
-
-                    // If neighbor is not part of contour, consider it a direction to try
-                    if (!contour.contains({nx, ny})) {
-                        std::vector<std::pair<int, int> > to_add;
-                        int cx = nx;
-                        int cy = ny;
-
-                        while (true) {
-                            // If out of bounds, break
-                            if (cx < 0 || cx >= dilated.cols || cy < 0 || cy >= dilated.rows)
-                                break;
-
-                            std::pair<int, int> current = {cx, cy};
-
-                            // Stop if this is not a neighbor
-                            if (!neighbors.contains(current))
-                                break;
-
-                            // Stop if we encounter another contour pixel
-                            if (contour.contains(current))
-                                break;
-
-                            // Otherwise, queue this pixel for addition
-                            to_add.push_back(current);
-
-                            cx += dx;
-                            cy += dy;
-                        }
-
-                        // If we ended because of a contour pixel, it's a valid bridge
-                        if (contour.contains({cx, cy})) {
-                            for (const auto &[px, py]: to_add) {
-                                dilated.at<uchar>(py, px) = 255;
-                                out_candidate_neighbors->insert({px, py});
-                            }
-                        }
-                    }
+        } else {
+            std::unordered_map<Color, int> colorLayers;
+            for (int y = 0; y < table.height; ++y)
+                for (int x = 0; x < table.width; ++x) {
+                    const Color color = canvas.getPixel({x, y}).color;
+                    if (!PixelArtImage::isSubjectColor(color, SUBJECT_THRESHOLD)) continue;
+                    auto [entry, inserted] = colorLayers.try_emplace(color, static_cast<int>(table.layers.size()));
+                    if (inserted) table.layers.push_back({color, {}, {}});
+                    addPixel(entry->second, x, y);
                 }
-            }
+        }
 
-            for (const auto &pt: contour) {
-                out_candidate_neighbors->insert(pt);
-            }
+        // Darkest first, dropping palette entries that no pixel uses; labels are only rewritten if that moved a layer
+        std::vector<int> order;
+        for (int i = 0; i < static_cast<int>(table.layers.size()); ++i)
+            if (!table.layers[i].points.empty()) order.push_back(i);
+        std::ranges::stable_sort(order, [&](int a, int b) {
+            return luminance(table.layers[a].color) < luminance(table.layers[b].color);
+        });
+
+        bool moved = order.size() != table.layers.size();
+        std::vector<int> ranks(table.layers.size(), -1);
+        std::vector<LayerTable::Layer> sorted;
+        sorted.reserve(order.size());
+        for (int rank = 0; rank < static_cast<int>(order.size()); ++rank) {
+            ranks[order[rank]] = rank;
+            moved |= order[rank] != rank;
+            sorted.push_back(std::move(table.layers[order[rank]]));
         }
+        table.layers = std::move(sorted);
+        if (moved)
+            for (int &label: table.labels)
+                if (label >= 0) label = ranks[label];
 
-        // Final result: union of original shape and dilated result
-        input_shape = dilated;
+        return table;
     }
 
-    static cv::Mat extractSubjectMask(const PixelArtImage &canvas) {
-        int width = canvas.getWidth();
-        int height = canvas.getHeight();
-
-        cv::Mat mask(height, width, CV_8UC1, cv::Scalar(0));
+    /**
+     * Builds the filled masks the trials composite: the first layers keep their own outline, filled,
+     * and the others are filled concave hulls of their pixels.
+     * @param table the layers of the canvas
+     * @return each layer's color and its filled full-canvas mask
+     */
+    std::vector<std::pair<Color, cv::Mat> > fillLayers(const LayerTable &table) const {
+        PF_PROFILE_SCOPE("fillLayers");
+        const int firstLayers = PRESERVE_OUTLINE ? 2 : 1;
+        std::vector<std::pair<Color, cv::Mat> > layers;
 
-        constexpr int threshold = 250; // tolerance for "near-white"
-        for (int y = 0; y < height; ++y) {
-            for (int x = 0; x < width; ++x) {
-                Color color = canvas.getPixel({x, y}).color;
-                if (color.r < threshold || color.g < threshold || color.b < threshold) {
-                    mask.at<uchar>(y, x) = 255;
-                }
+        for (int i = 0; i < static_cast<int>(table.layers.size()); ++i) {
+            const auto &layer = table.layers[i];
+            std::vector<std::vector<cv::Point> > contours;
+            if (i < firstLayers) {
+                // Only the layer's bounding box, with a one-pixel margin, is traced
+                cv::Rect region(layer.bounds.x - 1, layer.bounds.y - 1, layer.bounds.width + 2, layer.bounds.height + 2);
+                region &= cv::Rect(0, 0, table.width, table.height);
+                cv::findContours(table.mask(i, region), contours, cv::RETR_EXTERNAL, cv::CHAIN_APPROX_SIMPLE,
+                                 region.tl());
+            } else {
+                computeConcaveHull(layer.points, contours, 0.1);
             }
+
+            cv::Mat filledMask = cv::Mat::zeros(table.height, table.width, CV_8UC1);
+            cv::drawContours(filledMask, contours, -1, 255, cv::FILLED);
+            layers.emplace_back(layer.color, std::move(filledMask));
         }
 
-        return mask;
+        return layers;
     }
 };
 
@@ -5,7 +5,12 @@
 #ifndef CANVAS_H
 #define CANVAS_H
 
+#include "CowVector.h"
 #include "Pixel.h"
+#include "MemoryStats.h"
+#include "Orientation.h"
+#include "PaletteIndex.h"
+#include "SubjectMask.h"
 #include <vector>
 #include <string>
 #include <opencv2/core/mat.hpp>
@@ -24,18 +29,33 @@ public:
     PixelArtImage(int width, int height);
 
     /**
-     * Deep copy constructor for PixelArtImage objects.
+     * Copy constructor for PixelArtImage objects. The pixel layers, clusters and affected segments
+     * are copy-on-write: the copy shares them with the original until either side modifies them,
+     * so copying costs O(1) per layer instead of O(width * height).
      * @param other canvas to copy.
      */
     PixelArtImage(const PixelArtImage &other);
 
     /**
-     * Deep copy function.
+     * Move constructor; other is left a valid, empty 0x0 canvas.
+     * @param other canvas to move from.
+     */
+    PixelArtImage(PixelArtImage &&other) noexcept;
+
+    /**
+     * Copy function; shares the layers copy-on-write, as the copy constructor.
      * @param other canvas to copy
-     * @return deep-copied canvas
+     * @return this canvas, now equal to other
      */
     PixelArtImage &operator=(const PixelArtImage &other);
 
+    /**
+     * Move function; other is left a valid, empty 0x0 canvas.
+     * @param other canvas to move from
+     * @return this canvas, now holding other's layers
+     */
+    PixelArtImage &operator=(PixelArtImage &&other) noexcept;
+
     /**
      * Loads an image file into the PixelArtImage.
      * @param filepath path to the file.
@@ -70,6 +90,13 @@ public:
      */
     [[nodiscard]] Pixel getPixel(Pos pos) const;
 
+    /**
+     * Get the palette index plane of the image. It mirrors getPixel(): each entry is the
+     * index of the top-layer color, kept in sync by every pixel write.
+     * @return the palette index; check isValid() before use, it is dropped if the image has too many colors
+     */
+    [[nodiscard]] const PaletteIndex &getPaletteIndex() const { return paletteIndex; }
+
     /**
      * Get the PixelArtImage width
      * @return the width
@@ -88,6 +115,32 @@ public:
      */
     [[nodiscard]] std::vector<unsigned char> getRGBAData() const;
 
+    /**
+     * Accounts the memory held by the image: its pixel layers, overlays and cached analysis
+     * structures (clusters, affected segments, palette index). Layers shared copy-on-write with
+     * other images are counted in full by each of them.
+     * @return the bytes held per structure
+     */
+    [[nodiscard]] MemoryBreakdown getMemoryUsage() const;
+
+    /**
+     * Returns a counter that changes whenever the visible pixels (base, processed or debug layer) change.
+     * Callers cache derived data (textures, detection results) against it to avoid recomputing it every frame.
+     * @return the current content revision
+     */
+    [[nodiscard]] uint64_t getRevision() const { return revision; }
+
+    /**
+     * Records that the cached banding error, affected segments and banding overlay describe the current
+     * pixels, e.g. after a correction updated them in place, so views need not re-detect this revision.
+     */
+    void markBandingCurrent() { bandingRevision = revision; }
+
+    /**
+     * @return the revision last marked by markBandingCurrent(); copies carry the mark over to their own revision
+     */
+    [[nodiscard]] uint64_t getBandingRevision() const { return bandingRevision; }
+
     /**
      * Sets a pixel on the canvas' processed layer
      */
@@ -179,6 +232,23 @@ public:
      */
     std::vector<std::vector<std::vector<Pixel> > > segmentClusters(bool horizontalOrientation = true);
 
+    /**
+     * Computes the clusters as segmentClusters() does, without storing them in the canvas.
+     * The canvas is not modified, so any number of threads may call this on one canvas at once.
+     * @param horizontalOrientation If true, clusters are split into horizontal segments (by rows);
+     *                              if false, they are split into vertical segments (by columns).
+     * @return the clusters, as segmentClusters()
+     */
+    [[nodiscard]] std::vector<std::vector<std::vector<Pixel> > > computeClusters(bool horizontalOrientation = true) const;
+
+    /**
+     * Computes the clusters as computeClusters(bool) does, for an orientation known at compile time.
+     * @tparam O Horizontal or Vertical, the orientation of the segments
+     * @return the clusters, as segmentClusters()
+     */
+    template<typename O>
+    [[nodiscard]] std::vector<std::vector<std::vector<Pixel> > > computeClusters() const;
+
     /**
      * @brief Clears the highlighted pixels layer on the canvas.
      *
@@ -271,13 +341,48 @@ public:
      */
     [[nodiscard]] int getError() const;
 
+    /**
+     * Default tolerance for "near-white": a pixel with any channel below it belongs to the subject.
+     */
+    static constexpr int SUBJECT_THRESHOLD = 254;
+
     /**
      * Extracts the subject from a given canvas by creating a mask that highlights non-white areas.
      *
      * @param canvas The input Canvas object from which the subject will be extracted.
+     * @param threshold channel values below this mark a pixel as subject
      * @return A cv::Mat object representing a binary mask, where the subject areas are highlighted.
      */
-    static cv::Mat extractSubject(const PixelArtImage &canvas);
+    static cv::Mat extractSubject(const PixelArtImage &canvas, int threshold = SUBJECT_THRESHOLD);
+
+    /**
+     * Classifies the whole canvas in one pass, also producing the subject bitmask, bounding box and pixel count.
+     *
+     * @param canvas the canvas to classify (top layer of every pixel)
+     * @param threshold channel values below this mark a pixel as subject
+     * @return the subject mask
+     */
+    static SubjectMask analyzeSubject(const PixelArtImage &canvas, int threshold = SUBJECT_THRESHOLD);
+
+    /**
+     * Tells whether a single color belongs to the subject, using the same rule as extractSubject.
+     * Meant for local queries that only look at a handful of pixels.
+     *
+     * @param color the color to classify
+     * @param threshold channel values below this mark a pixel as subject
+     * @return true if the color is not near-white background
+     */
+    static bool isSubjectColor(const Color &color, int threshold = SUBJECT_THRESHOLD);
+
+    /**
+     * Converts one decoded file pixel to a color, the way loadFromFile does: missing channels repeat the
+     * first one and a fourth channel (alpha) is ignored, so gray with alpha reads as (gray, alpha, gray).
+     *
+     * @param pixel the pixel's first channel
+     * @param channels the number of channels per pixel, 1 to 4
+     * @return the pixel's color
+     */
+    static Color decodedColor(const unsigned char *pixel, int channels);
 
     /**
      * Retrieves the generator pixel of the canvas, if available.
@@ -324,10 +429,43 @@ public:
      */
     [[nodiscard]] const std::vector<Pixel> &getDrawnPath() const;
 
-    [[nodiscard]] std::vector<std::vector<Pixel>> getAffectedSegments() const;
+    [[nodiscard]] const std::vector<std::vector<Pixel>> &getAffectedSegments() const;
 
+    /**
+     * Stores the segments affected by banding and indexes them for hit-testing:
+     * a per-pixel grid of segment ids and the bounding box of every segment.
+     * Where segments overlap (a horizontal and a vertical one), the later segment owns the pixel.
+     *
+     * @param affectedSegs the affected segments, e.g. from BandingDetection
+     */
     void setAffectedSegments(std::vector<std::vector<Pixel>> affectedSegs) ;
 
+    /**
+     * Drops some affected segments and appends others, e.g. after a local correction. Only the grid cells
+     * under the dropped, added and renumbered segments are rewritten; the result is the same as
+     * setAffectedSegments() with the kept segments, in order, followed by the added ones.
+     *
+     * @param removed indices into getAffectedSegments() of the segments to drop
+     * @param added the segments to append
+     */
+    void updateAffectedSegments(const std::vector<int> &removed, std::vector<std::vector<Pixel>> added);
+
+    /**
+     * Looks up the affected segment covering a pixel in constant time.
+     *
+     * @param pos the pixel position
+     * @return the index into getAffectedSegments(), or -1 if no affected segment covers pos
+     */
+    [[nodiscard]] int getAffectedSegmentAt(Pos pos) const;
+
+    /**
+     * Returns the bounding box of an affected segment, computed when the segments were set.
+     *
+     * @param id an index into getAffectedSegments()
+     * @return the inclusive minimum and maximum pixel positions of the segment
+     */
+    [[nodiscard]] std::pair<Pos, Pos> getAffectedSegmentBounds(int id) const;
+
 
     /**
      * @brief Draws a rectangle around the bounding box of a set of pixels on the canvas.
@@ -345,17 +483,28 @@ public:
 
 private:
     int width, height;
-    std::vector<Pixel> pixels;
-    std::vector<std::optional<Pixel> > processedPixels;
-    std::vector<std::optional<Pixel> > debugPixels;
+    // Large structures are copy-on-write; mutate them through write() (or assign()) only
+    CowVector<Pixel> pixels;
+    CowVector<std::optional<Pixel> > processedPixels;
+    CowVector<std::optional<Pixel> > debugPixels;
     std::vector<std::tuple<glm::vec2, glm::vec2, Color> > debugLines;
-    std::vector<std::optional<Pixel> > highlightedPixels; // Stores pixels that are highlighted (hovered over)
-    std::vector<std::vector<std::vector<Pixel> > > clusters;
+    CowVector<std::optional<Pixel> > highlightedPixels; // Stores pixels that are highlighted (hovered over)
+    CowVector<std::vector<std::vector<Pixel> > > clusters;
     std::vector<Pixel> selectedSegment;
     std::optional<Pixel> generator;
     std::vector<Pixel> drawnPath;
-    std::vector<std::vector<Pixel> > affectedSegments;
-    int error;
+    CowVector<std::vector<Pixel> > affectedSegments;
+    CowVector<int> affectedSegmentIds; // per pixel, -1 where no affected segment
+    std::vector<std::pair<Pos, Pos> > affectedSegmentBounds;
+    PaletteIndex paletteIndex;
+    int error = 0;
+    uint64_t revision = 0;
+    uint64_t bandingRevision = 0;
+
+    void rebuildPaletteIndex();
+    template<typename O>
+    std::vector<std::vector<std::vector<Pixel> > > segmentClustersFromRuns() const;
+    void syncPaletteIndex(int index);
 };
 
 #endif // CANVAS_H
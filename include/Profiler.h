@@ -0,0 +1,116 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#pragma once
+#include <chrono>
+#include <string>
+#include <vector>
+
+/**
+ * Opens a timing zone that lasts until the end of the enclosing scope.
+ * Compiles to nothing unless PIXELFIXER_PROFILING is defined.
+ * @param name a string literal naming the stage
+ */
+#ifdef PIXELFIXER_PROFILING
+#define PF_PROFILE_CONCAT_INNER(a, b) a##b
+#define PF_PROFILE_CONCAT(a, b) PF_PROFILE_CONCAT_INNER(a, b)
+#define PF_PROFILE_SCOPE(name) ProfileZone PF_PROFILE_CONCAT(profileZone_, __LINE__)(name)
+#else
+#define PF_PROFILE_SCOPE(name) ((void) 0)
+#endif
+
+/**
+ * @class Profiler
+ * Collects hierarchical timing zones from all threads.
+ *
+ * Zones recorded on the GUI thread are aggregated per frame; zones recorded elsewhere
+ * while a run is open (or anywhere, in headless tools that never call beginFrame)
+ * are aggregated per run. Every zone is also kept as a trace event for Chrome's
+ * trace_event JSON format (chrome://tracing, Perfetto).
+ */
+class Profiler {
+public:
+    /**
+     * Aggregated timings of one zone, keyed by its path in the zone hierarchy.
+     */
+    struct ZoneStats {
+        std::string path; // parent zones joined by '/'
+        std::string name;
+        int depth = 0;
+        int calls = 0;
+        double totalMs = 0.0;
+    };
+
+    /**
+     * @return true if the zones were compiled in.
+     */
+    static constexpr bool isEnabled() {
+#ifdef PIXELFIXER_PROFILING
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    /**
+     * Closes the previous frame's statistics and marks the calling thread as the GUI thread.
+     */
+    static void beginFrame();
+
+    /**
+     * Starts collecting per-run statistics, discarding the previous run's.
+     */
+    static void beginRun();
+
+    /**
+     * Stops collecting per-run statistics.
+     */
+    static void endRun();
+
+    /**
+     * @return the zones of the last completed frame, in hierarchy order.
+     */
+    static std::vector<ZoneStats> getFrameStats();
+
+    /**
+     * @return the zones of the current or last run, in hierarchy order.
+     */
+    static std::vector<ZoneStats> getRunStats();
+
+    /**
+     * Writes every recorded zone as Chrome trace_event JSON.
+     * @param filepath destination file
+     * @return true if the file was written
+     */
+    static bool exportChromeTrace(const std::string &filepath);
+
+    /**
+     * Drops all recorded trace events and statistics.
+     */
+    static void clear();
+
+    /**
+     * Records a finished zone. Called by ProfileZone.
+     */
+    static void record(const std::string &path, const char *name, int depth,
+                       std::chrono::steady_clock::time_point start, std::chrono::steady_clock::time_point end);
+};
+
+/**
+ * @class ProfileZone
+ * RAII timing zone; use through PF_PROFILE_SCOPE.
+ */
+class ProfileZone {
+public:
+    explicit ProfileZone(const char *name);
+    ~ProfileZone();
+
+    ProfileZone(const ProfileZone &) = delete;
+    ProfileZone &operator=(const ProfileZone &) = delete;
+
+private:
+    const char *name;
+    std::chrono::steady_clock::time_point start;
+};
+
+#endif //PROFILER_H
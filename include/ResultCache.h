@@ -0,0 +1,81 @@
+#ifndef RESULTCACHE_H
+#define RESULTCACHE_H
+
+#pragma once
+#include "Algorithm.h"
+#include "PixelArtImage.h"
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <string>
+
+/**
+ * @class ResultCache
+ * A content-addressed on-disk cache of processed images.
+ *
+ * Entries are keyed by a hash of the input's pixels, the algorithm's name and parameters, the
+ * generator, drawn path and selected segment, and TOOL_VERSION. Each entry is a PNG of the result
+ * plus a small report file holding its banding error; the report is written last, so an entry
+ * exists exactly when its report does. Files are written under a temporary name and renamed
+ * into place, so several processes can share one cache directory.
+ *
+ * A lookup refreshes the entry's report time stamp; once the cache grows past its capacity,
+ * the least recently used entries are removed.
+ */
+class ResultCache {
+public:
+    /**
+     * Part of every key; bump it whenever an algorithm's output changes for the same settings.
+     */
+    static constexpr const char *TOOL_VERSION = "pixelfixer-1";
+
+    struct Entry {
+        std::filesystem::path image; // the cached result
+        int bandingError = 0;
+    };
+
+    /**
+     * @param directory where entries are stored; created if missing
+     * @param capacityBytes size the cache is trimmed to after every store
+     */
+    ResultCache(std::filesystem::path directory, std::uintmax_t capacityBytes);
+
+    /**
+     * Computes the cache key of running an algorithm on an image.
+     * Call it before run(), while the image shows the input pixels.
+     * @param input the image the algorithm will run on
+     * @param algorithm the configured algorithm
+     * @return a 32 character hexadecimal key
+     */
+    [[nodiscard]] static std::string key(const PixelArtImage &input, const Algorithm &algorithm);
+
+    /**
+     * Looks up an entry and marks it as recently used.
+     * @param key a key from key()
+     * @return the entry, or nothing on a miss
+     */
+    [[nodiscard]] std::optional<Entry> find(const std::string &key) const;
+
+    /**
+     * Stores a result, then evicts least recently used entries beyond the capacity.
+     * @param key a key from key()
+     * @param result the processed image, saved as with PixelArtImage::saveToFile
+     * @param bandingError the result's banding error
+     * @return true if the entry was written
+     */
+    bool store(const std::string &key, const PixelArtImage &result, int bandingError) const;
+
+    [[nodiscard]] bool isValid() const { return valid; }
+
+    [[nodiscard]] const std::filesystem::path &getDirectory() const { return directory; }
+
+private:
+    std::filesystem::path directory;
+    std::uintmax_t capacity;
+    bool valid = false;
+
+    [[nodiscard]] std::filesystem::path temporaryPath(const std::string &name) const;
+    void evict() const;
+};
+
+#endif //RESULTCACHE_H
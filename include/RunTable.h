@@ -0,0 +1,115 @@
+#ifndef RUNTABLE_H
+#define RUNTABLE_H
+
+#pragma once
+#include "PaletteIndex.h"
+#include <cstdint>
+#include <span>
+#include <vector>
+
+/**
+ * @class RunTable
+ * The maximal runs of equal palette indices in every row of an index plane.
+ *
+ * Rows are compared with themselves shifted by one element, 32 elements at a time
+ * (AVX2 or NEON), into a run-start bitmask; the set bits are then turned into run boundaries
+ * with count-trailing-zeros. Scalar code handles the row tails and other targets.
+ */
+class RunTable {
+public:
+    /**
+     * One run of a row; start and end are inclusive column indices.
+     */
+    struct Run {
+        int start;
+        int end;
+        uint16_t id;
+
+        [[nodiscard]] int length() const { return end - start + 1; }
+    };
+
+    /**
+     * Marks where a new run begins in one row: bit x is set if x == 0 or row[x] != row[x - 1].
+     * @param row the row's palette indices
+     * @param starts receives (row.size() + 63) / 64 words
+     */
+    static void runStarts(std::span<const uint8_t> row, uint64_t *starts);
+
+    /**
+     * @copydoc runStarts(std::span<const uint8_t>, uint64_t *)
+     */
+    static void runStarts(std::span<const uint16_t> row, uint64_t *starts);
+
+    /**
+     * @copydoc runStarts(std::span<const uint8_t>, uint64_t *)
+     */
+    static void runStarts(std::span<const uint32_t> row, uint64_t *starts);
+
+    /**
+     * Compares two rows element by element: bit x is set if a[x] != b[x].
+     * Used with consecutive rows, this marks where vertical runs begin.
+     * @param a the first row
+     * @param b the second row, as long as the first
+     * @param out receives (a.size() + 63) / 64 words
+     */
+    static void rowDifferences(std::span<const uint8_t> a, std::span<const uint8_t> b, uint64_t *out);
+
+    /**
+     * @copydoc rowDifferences(std::span<const uint8_t>, std::span<const uint8_t>, uint64_t *)
+     */
+    static void rowDifferences(std::span<const uint16_t> a, std::span<const uint16_t> b, uint64_t *out);
+
+    /**
+     * @copydoc rowDifferences(std::span<const uint8_t>, std::span<const uint8_t>, uint64_t *)
+     */
+    static void rowDifferences(std::span<const uint32_t> a, std::span<const uint32_t> b, uint64_t *out);
+
+    /**
+     * Builds the runs of every row of a row-major index plane.
+     * @param plane width * height palette indices
+     * @param width in elements
+     * @param height in rows
+     * @return the run table
+     */
+    template<typename T>
+    static RunTable build(std::span<const T> plane, int width, int height);
+
+    /**
+     * Builds the runs of every row of an image's palette index plane.
+     * @param index a valid palette index
+     * @param width of the image
+     * @param height of the image
+     * @return the run table
+     */
+    static RunTable build(const PaletteIndex &index, int width, int height);
+
+    /**
+     * @param y a row index
+     * @return the runs of the row, left to right
+     */
+    [[nodiscard]] std::span<const Run> row(int y) const {
+        return {runs.data() + rowOffsets[y], runs.data() + rowOffsets[y + 1]};
+    }
+
+    /**
+     * @return every run, row after row
+     */
+    [[nodiscard]] const std::vector<Run> &getRuns() const { return runs; }
+
+    /**
+     * @param y a row index
+     * @return the index into getRuns() of the row's first run
+     */
+    [[nodiscard]] int rowBegin(int y) const { return rowOffsets[y]; }
+
+    [[nodiscard]] int getWidth() const { return width; }
+    [[nodiscard]] int getHeight() const { return height; }
+
+private:
+    int width = 0;
+    int height = 0;
+    std::vector<Run> runs;
+    std::vector<int> rowOffsets{0};
+};
+
+#endif //RUNTABLE_H
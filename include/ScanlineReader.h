@@ -0,0 +1,60 @@
+#ifndef SCANLINEREADER_H
+#define SCANLINEREADER_H
+
+#pragma once
+#include "ImageView.h"
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+/**
+ * @class ScanlineReader
+ * Reads a binary PGM (P5) or PPM (P6) file one row at a time, holding a single row in memory.
+ * Only 8-bit files (maxval up to 255) are supported.
+ */
+class ScanlineReader {
+public:
+    /**
+     * Opens the file and parses its header; errors are reported to std::cerr.
+     * @param path the image file
+     */
+    explicit ScanlineReader(const std::string &path);
+
+    /**
+     * @param path an image file
+     * @return whether the file starts like a binary PGM or PPM file
+     */
+    static bool isSupported(const std::string &path);
+
+    /**
+     * @return true if the header was parsed and no read has failed so far
+     */
+    [[nodiscard]] bool isValid() const { return valid; }
+
+    [[nodiscard]] int getWidth() const { return width; }
+
+    [[nodiscard]] int getHeight() const { return height; }
+
+    /**
+     * @return Gray8 for PGM files, RGB8 for PPM files
+     */
+    [[nodiscard]] PixelFormat getFormat() const { return format; }
+
+    /**
+     * Reads the next row.
+     * @return the row's pixels, valid until the next call; nullptr after the last row or on a read error
+     */
+    const uint8_t *readRow();
+
+private:
+    std::ifstream file;
+    bool valid = false;
+    int width = 0;
+    int height = 0;
+    int rowsRead = 0;
+    PixelFormat format = PixelFormat::Gray8;
+    std::vector<uint8_t> row;
+};
+
+#endif //SCANLINEREADER_H
@@ -0,0 +1,69 @@
+#ifndef STREAMINGBANDINGGATE_H
+#define STREAMINGBANDINGGATE_H
+
+#pragma once
+#include "BitboardBandingDetector.h"
+#include "ImageView.h"
+#include "PixelArtImage.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * @class StreamingBandingGate
+ * Counts the banding pairs of an image fed to it row by row, e.g. straight from a scanline decoder,
+ * for quality gates that only need the error.
+ *
+ * The gate holds the previous row and a run state per column, so its memory depends on the image
+ * width only: a strip atlas of any height is gated in a few bytes per column. The count equals
+ * BandingDetection's for the same pixels.
+ */
+class StreamingBandingGate {
+public:
+    /**
+     * @param width row length in pixels
+     * @param format the layout of the rows that will be pushed
+     * @param subjectThreshold channel values below this mark a pixel as subject
+     */
+    StreamingBandingGate(int width, PixelFormat format, int subjectThreshold = PixelArtImage::SUBJECT_THRESHOLD);
+
+    /**
+     * Consumes the next row.
+     * @param row width pixels in the gate's format
+     */
+    void pushRow(const uint8_t *row);
+
+    /**
+     * Closes the runs of the last row.
+     * @return the number of distinct banding pairs of the pushed rows
+     */
+    int finish();
+
+    [[nodiscard]] int getRows() const { return rows; }
+
+    /**
+     * @return the bytes held by the gate; independent of the number of rows pushed
+     */
+    [[nodiscard]] size_t memoryBytes() const;
+
+    /**
+     * Gates an image file. Binary PGM and PPM files are streamed row by row; other formats
+     * are decoded whole first, and only their rows are streamed, with the pixels converted
+     * as PixelArtImage::loadFromFile converts them; those hold O(width * height) memory.
+     * @param path the image file
+     * @param subjectThreshold channel values below this mark a pixel as subject
+     * @return the banding error, or -1 if the file cannot be read
+     */
+    static int evaluateFile(const std::string &path, int subjectThreshold = PixelArtImage::SUBJECT_THRESHOLD);
+
+private:
+    int width;
+    PixelFormat format;
+    int subjectThreshold;
+    int rows = 0;
+    BitboardBandingDetector detector;
+    std::vector<uint32_t> keys;
+    std::vector<uint64_t> subjectBits;
+};
+
+#endif //STREAMINGBANDINGGATE_H
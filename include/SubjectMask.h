@@ -0,0 +1,74 @@
+#ifndef SUBJECTMASK_H
+#define SUBJECTMASK_H
+
+#pragma once
+#include <cstdint>
+#include <functional>
+#include <vector>
+#include <opencv2/core/mat.hpp>
+
+/**
+ * @class SubjectMask
+ * Near-white background classification of a whole image, computed one packed row at a time.
+ *
+ * A pixel belongs to the subject when any of its color channels is below the threshold.
+ * The classification is produced both as a byte mask (for OpenCV) and as a bitmask
+ * (for word-parallel analysis), together with the subject's bounding box and pixel count.
+ */
+class SubjectMask {
+public:
+    cv::Mat mask;               // CV_8UC1, 255 on subject pixels
+    std::vector<uint64_t> bits; // row-major, wordsPerRow words per row; bit (x % 64) of word (x / 64)
+    int wordsPerRow = 0;
+    int count = 0;              // number of subject pixels
+    cv::Rect bounds;            // bounding box of the subject; empty if there is none
+
+    /**
+     * Classifies a packed RGBA (or RGB) image.
+     *
+     * @param data top-left pixel of the image, rows stored back to back
+     * @param width in pixels
+     * @param height in pixels
+     * @param channels 3 for RGB or 4 for RGBA; alpha is ignored
+     * @param threshold channel values below this mark a pixel as subject
+     * @return the masks, bounds and count of the subject
+     */
+    static SubjectMask compute(const uint8_t *data, int width, int height, int channels, int threshold);
+
+    /**
+     * Classifies an image whose packed rows are produced on demand, so callers holding the pixels
+     * in another layout need only one row of packed storage instead of a copy of the whole image.
+     *
+     * @param width in pixels
+     * @param height in pixels
+     * @param channels 3 for RGB or 4 for RGBA; alpha is ignored
+     * @param threshold channel values below this mark a pixel as subject
+     * @param row returns the packed row y; the pointer only needs to stay valid until the next call
+     * @return the masks, bounds and count of the subject
+     */
+    static SubjectMask compute(int width, int height, int channels, int threshold,
+                               const std::function<const uint8_t *(int y)> &row);
+
+    /**
+     * Classifies one packed row. This is the kernel behind compute(), exposed for streaming callers.
+     *
+     * @param row first pixel of the row
+     * @param width in pixels
+     * @param channels 3 for RGB or 4 for RGBA; alpha is ignored
+     * @param threshold channel values below this mark a pixel as subject
+     * @param maskRow receives 255 or 0 per pixel; may be null
+     * @param bitRow receives (width + 63) / 64 words, one bit per pixel; may be null
+     * @return the number of subject pixels in the row
+     */
+    static int classifyRow(const uint8_t *row, int width, int channels, int threshold,
+                           uint8_t *maskRow, uint64_t *bitRow);
+
+    /**
+     * @return true if the pixel at (x, y) is part of the subject
+     */
+    [[nodiscard]] bool contains(int x, int y) const {
+        return (bits[static_cast<size_t>(y) * wordsPerRow + x / 64] >> (x % 64)) & 1u;
+    }
+};
+
+#endif //SUBJECTMASK_H
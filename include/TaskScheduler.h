@@ -0,0 +1,179 @@
+#ifndef TASKSCHEDULER_H
+#define TASKSCHEDULER_H
+
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class TaskGroup;
+
+/**
+ * @class TaskScheduler
+ * A work-stealing thread pool shared by every level of parallelism: images of a batch, trials or
+ * passes of one algorithm run, and rows or tiles of one image.
+ *
+ * Each worker owns a deque. Tasks submitted from a worker go to the back of its own deque and are
+ * taken back LIFO, so nested fork/join work stays hot in cache; idle workers steal from the front
+ * of the other deques. A thread waiting on a TaskGroup runs queued tasks instead of blocking, so
+ * nesting groups inside tasks never deadlocks and never needs more threads than workers.
+ *
+ * A scheduler with zero workers runs every task inline on the submitting thread.
+ */
+class TaskScheduler {
+public:
+    /**
+     * Affinity hint meaning "no preference".
+     */
+    static constexpr int ANY_WORKER = -1;
+
+    /**
+     * @param workerCount background threads; the thread waiting on a group also runs tasks
+     */
+    explicit TaskScheduler(int workerCount);
+    ~TaskScheduler();
+
+    TaskScheduler(const TaskScheduler &) = delete;
+    TaskScheduler &operator=(const TaskScheduler &) = delete;
+
+    /**
+     * @return the process-wide scheduler, created on first use
+     */
+    static TaskScheduler &global();
+
+    /**
+     * Sets the total parallelism of the global scheduler: the calling thread plus threads - 1 workers.
+     * Must not be called while tasks are in flight.
+     * @param threads 1 runs everything serially; 0 or less uses every hardware thread
+     */
+    static void setGlobalThreadCount(int threads);
+
+    [[nodiscard]] int getWorkerCount() const { return static_cast<int>(workers.size()); }
+
+    /**
+     * @return true if the calling thread is one of this scheduler's workers
+     */
+    [[nodiscard]] bool isWorkerThread() const;
+
+private:
+    friend class TaskGroup;
+
+    struct Task {
+        std::function<void()> function;
+        TaskGroup *group;
+    };
+
+    struct Queue {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+
+    std::vector<std::thread> workers;
+    std::vector<std::unique_ptr<Queue> > queues;
+    std::atomic<int> queued{0};
+    std::atomic<bool> stopping{false};
+    std::atomic<unsigned> nextQueue{0};
+
+    // Sleeping workers and waiters are woken when tasks are queued or a group completes
+    std::mutex sleepMutex;
+    std::condition_variable wake;
+
+    void submit(Task task, int affinity);
+    bool tryRunOne();
+    void execute(Task &task);
+    void notifyAll();
+    void workerLoop(int index);
+};
+
+/**
+ * @class TaskGroup
+ * Fork/join over a TaskScheduler: run() forks tasks, wait() joins them.
+ *
+ * The first exception thrown by a task is rethrown by wait(); the remaining tasks still run.
+ * The destructor waits for tasks that were never joined.
+ */
+class TaskGroup {
+public:
+    explicit TaskGroup(TaskScheduler &scheduler = TaskScheduler::global()) : scheduler(scheduler) {
+    }
+
+    ~TaskGroup();
+
+    TaskGroup(const TaskGroup &) = delete;
+    TaskGroup &operator=(const TaskGroup &) = delete;
+
+    /**
+     * Forks a task.
+     * @param function the work; it must outlive neither the group nor anything it captures by reference
+     * @param affinity preferred worker index (taken modulo the worker count), or ANY_WORKER;
+     *                 only a hint, idle workers may still steal the task
+     */
+    void run(std::function<void()> function, int affinity = TaskScheduler::ANY_WORKER);
+
+    /**
+     * Runs queued tasks until every task of the group has finished.
+     */
+    void wait();
+
+    [[nodiscard]] TaskScheduler &getScheduler() const { return scheduler; }
+
+private:
+    friend class TaskScheduler;
+
+    TaskScheduler &scheduler;
+    std::atomic<int> pending{0};
+    std::mutex errorMutex;
+    std::exception_ptr error;
+
+    void finishTask(std::exception_ptr taskError);
+};
+
+/**
+ * Calls fn(i) for every i in [begin, end), in chunks of at least `grain` indices run as tasks.
+ * Returns once every call has finished; the first exception thrown is rethrown.
+ * @param begin first index
+ * @param end one past the last index
+ * @param grain minimum chunk size; pick it so that one chunk is worth a task
+ * @param fn the loop body, called concurrently for different indices
+ * @param scheduler the scheduler to run on
+ */
+template<typename Function>
+void parallelFor(int begin, int end, int grain, Function &&fn, TaskScheduler &scheduler = TaskScheduler::global()) {
+    if (end <= begin) return;
+    grain = std::max(grain, 1);
+
+    // A few chunks per thread leave room for stealing when chunks are uneven
+    const int threads = scheduler.getWorkerCount() + 1;
+    const int chunk = std::max(grain, (end - begin + threads * 4 - 1) / (threads * 4));
+    if (threads == 1 || end - begin <= chunk) {
+        for (int i = begin; i < end; ++i) fn(i);
+        return;
+    }
+
+    TaskGroup group(scheduler);
+    for (int from = begin + chunk; from < end; from += chunk) {
+        const int to = std::min(from + chunk, end);
+        group.run([&fn, from, to] {
+            for (int i = from; i < to; ++i) fn(i);
+        });
+    }
+
+    // The calling thread takes the first chunk itself
+    std::exception_ptr firstError;
+    try {
+        for (int i = begin; i < begin + chunk; ++i) fn(i);
+    } catch (...) {
+        firstError = std::current_exception();
+    }
+    group.wait();
+    if (firstError) std::rethrow_exception(firstError);
+}
+
+#endif //TASKSCHEDULER_H
@@ -0,0 +1,29 @@
+#ifndef THREADCPUCLOCK_H
+#define THREADCPUCLOCK_H
+
+#pragma once
+#include <chrono>
+
+/**
+ * @class ThreadCpuClock
+ * A std::chrono clock that counts the CPU time consumed by the calling thread.
+ *
+ * Time budgets measured with it do not shrink while the thread waits for a core, so a search
+ * does the same amount of work whether it runs alone or beside other tasks. Where the platform
+ * has no per-thread CPU clock, it falls back to steady_clock wall time.
+ */
+class ThreadCpuClock {
+public:
+    using duration = std::chrono::nanoseconds;
+    using rep = duration::rep;
+    using period = duration::period;
+    using time_point = std::chrono::time_point<ThreadCpuClock>;
+    static constexpr bool is_steady = true;
+
+    /**
+     * @return the CPU time the calling thread has used so far; only differences on one thread are meaningful
+     */
+    static time_point now() noexcept;
+};
+
+#endif //THREADCPUCLOCK_H
@@ -0,0 +1,73 @@
+#ifndef VIEWDETECTION_H
+#define VIEWDETECTION_H
+
+#pragma once
+#include "BitboardBandingDetector.h"
+#include "ImageView.h"
+#include "PaletteIndex.h"
+#include "PixelArtImage.h"
+#include <cstdint>
+#include <vector>
+
+/**
+ * @class DetectionScratch
+ * The reusable state of detectBanding(). After the first call, calls on images of the same
+ * or a smaller size allocate nothing. A scratch must not be used by two threads at once;
+ * keep one per thread, e.g. as a thread_local.
+ */
+class DetectionScratch {
+private:
+    BitboardBandingDetector detector{0, false};
+    std::vector<uint32_t> keys;
+    std::vector<uint64_t> subjectBits;
+    std::vector<bool> subjectEntries;
+
+    friend int detectBanding(const ImageView &image, DetectionScratch &scratch,
+                             std::vector<BitboardBandingDetector::Pair> *pairs, int subjectThreshold);
+    friend int detectBanding(const PaletteIndex &index, int width, int height, DetectionScratch &scratch,
+                             std::vector<BitboardBandingDetector::Pair> *pairs, int subjectThreshold);
+};
+
+/**
+ * Converts one row of raw pixels to the color keys and subject bits that BitboardBandingDetector consumes.
+ *
+ * @param row the first byte of the row
+ * @param width in pixels
+ * @param format the pixel layout
+ * @param subjectThreshold channel values below this mark a pixel as subject
+ * @param keys receives one color key per pixel
+ * @param subjectBits receives (width + 63) / 64 words, bit x set if pixel x is subject
+ */
+void packRow(const uint8_t *row, int width, PixelFormat format, int subjectThreshold, uint32_t *keys,
+             uint64_t *subjectBits);
+
+/**
+ * Counts the banding pairs of raw pixels, without building a PixelArtImage.
+ * Pixels with any color channel below the threshold are subject, as in PixelArtImage::isSubjectColor.
+ *
+ * @param image the pixels
+ * @param scratch reusable state
+ * @param pairs receives the banding pairs (horizontal ones first), or nullptr to only count
+ * @param subjectThreshold channel values below this mark a pixel as subject
+ * @return the number of distinct banding pairs, or -1 if the view is invalid
+ */
+int detectBanding(const ImageView &image, DetectionScratch &scratch,
+                  std::vector<BitboardBandingDetector::Pair> *pairs = nullptr,
+                  int subjectThreshold = PixelArtImage::SUBJECT_THRESHOLD);
+
+/**
+ * Counts the banding pairs of a palette index plane, e.g. of a candidate image in a search loop.
+ *
+ * @param index the palette index of the image
+ * @param width of the image
+ * @param height of the image
+ * @param scratch reusable state
+ * @param pairs receives the banding pairs (horizontal ones first), or nullptr to only count
+ * @param subjectThreshold channel values below this mark a pixel as subject
+ * @return the number of distinct banding pairs, or -1 if the palette index is invalid
+ */
+int detectBanding(const PaletteIndex &index, int width, int height, DetectionScratch &scratch,
+                  std::vector<BitboardBandingDetector::Pair> *pairs = nullptr,
+                  int subjectThreshold = PixelArtImage::SUBJECT_THRESHOLD);
+
+#endif //VIEWDETECTION_H
@@ -0,0 +1,62 @@
+#include "../include/AlgorithmJob.h"
+#include "../include/Profiler.h"
+#include <exception>
+#include <iostream>
+
+AlgorithmJob::AlgorithmJob(Algorithm &algorithm, PixelArtImage &target, std::function<void()> onFinished)
+    : algorithm(algorithm), target(target), snapshot(target) {
+    algorithm.clearRunState();
+    algorithm.setPixelArtImage(snapshot);
+    algorithm.reset();
+
+    worker = std::thread([this, onFinished = std::move(onFinished)] {
+        Profiler::beginRun();
+        try {
+            PF_PROFILE_SCOPE("Algorithm::run");
+            this->algorithm.run();
+        } catch (const std::exception &e) {
+            std::cerr << "Algorithm \"" << this->algorithm.name() << "\" failed: " << e.what() << std::endl;
+            failed = true;
+        } catch (...) {
+            std::cerr << "Algorithm \"" << this->algorithm.name() << "\" failed with an unknown exception" << std::endl;
+            failed = true;
+        }
+        Profiler::endRun();
+        finished = true;
+        if (onFinished) onFinished();
+    });
+}
+
+AlgorithmJob::~AlgorithmJob() {
+    if (worker.joinable()) {
+        cancel();
+        worker.join();
+    }
+    algorithm.setPixelArtImage(target);
+}
+
+bool AlgorithmJob::isFinished() const {
+    return finished.load();
+}
+
+float AlgorithmJob::getProgress() const {
+    return algorithm.getProgress();
+}
+
+void AlgorithmJob::cancel() {
+    cancelled = true;
+    algorithm.requestCancel();
+}
+
+bool AlgorithmJob::collect() {
+    if (worker.joinable())
+        worker.join();
+
+    algorithm.setPixelArtImage(target);
+
+    if (cancelled || failed)
+        return false;
+
+    target = snapshot;
+    return true;
+}
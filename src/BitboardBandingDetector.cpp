@@ -0,0 +1,262 @@
+#include "../include/BitboardBandingDetector.h"
+#include "../include/MemoryStats.h"
+#include "../include/PixelArtImage.h"
+#include "../include/Profiler.h"
+#include "../include/RunTable.h"
+#include <algorithm>
+#include <bit>
+#include <cstring>
+
+namespace {
+    // Sets bit x of `bits` if the palette entry of row[x] is subject
+    template<typename T>
+    void subjectRow(std::span<const T> row, const std::vector<bool> &subjectEntries, std::vector<uint64_t> &bits) {
+        std::ranges::fill(bits, 0);
+        for (size_t x = 0; x < row.size(); ++x) {
+            if (subjectEntries[row[x]])
+                bits[x / 64] |= uint64_t{1} << (x % 64);
+        }
+    }
+}
+
+BitboardBandingDetector::BitboardBandingDetector(int width, bool collectPairs) {
+    reset(width, collectPairs);
+}
+
+void BitboardBandingDetector::reset(int width, bool collectPairs) {
+    this->width = width;
+    words = (width + 63) / 64;
+    rows = 0;
+    this->collectPairs = collectPairs;
+
+    // assign() keeps the capacity of vectors that are already large enough
+    previousRow.clear();
+    previousStarts.assign(words, 0);
+    previousEnds.assign(words, 0);
+    previousSubject.assign(words, 0);
+    previousVerticalStarts.assign(words, 0);
+    pending.assign(words, 0);
+    pendingStartRow.assign(width, 0);
+    starts.assign(words, 0);
+    ends.assign(words, 0);
+    differences.assign(words, 0);
+    scratch.assign(words, 0);
+
+    result.error = 0;
+    result.pairs.clear();
+    result.rowPairCounts.clear();
+    result.columnPairCounts.assign(std::max(width - 1, 0), 0);
+    verticalPairs.clear();
+}
+
+template<typename T>
+void BitboardBandingDetector::pushRow(std::span<const T> indices, const uint64_t *subjectBits) {
+    RunTable::runStarts(indices, starts.data());
+    computeEnds(starts, ends);
+
+    if (rows == 0) {
+        // Every vertical run of the first row starts there
+        std::ranges::fill(differences, ~uint64_t{0});
+        if (width % 64 != 0) differences[words - 1] = (uint64_t{1} << (width % 64)) - 1;
+    } else {
+        const std::span<const T> previous(reinterpret_cast<const T *>(previousRow.data()), indices.size());
+        RunTable::rowDifferences(indices, previous, differences.data());
+
+        // The previous row's vertical runs end wherever this row differs from it
+        verticalStep(rows - 1, differences.data());
+        horizontalStep(rows, subjectBits);
+    }
+
+    previousRow.resize(indices.size_bytes());
+    std::memcpy(previousRow.data(), indices.data(), indices.size_bytes());
+    std::swap(previousStarts, starts);
+    std::swap(previousEnds, ends);
+    std::copy_n(subjectBits, words, previousSubject.begin());
+    std::swap(previousVerticalStarts, differences);
+    ++rows;
+}
+
+template void BitboardBandingDetector::pushRow<uint8_t>(std::span<const uint8_t>, const uint64_t *);
+template void BitboardBandingDetector::pushRow<uint16_t>(std::span<const uint16_t>, const uint64_t *);
+template void BitboardBandingDetector::pushRow<uint32_t>(std::span<const uint32_t>, const uint64_t *);
+
+BitboardBandingDetector::Result BitboardBandingDetector::finish() {
+    close();
+    return std::move(result);
+}
+
+const BitboardBandingDetector::Result &BitboardBandingDetector::close() {
+    if (rows > 0) {
+        // Every vertical run still open ends on the last row
+        std::ranges::fill(scratch, ~uint64_t{0});
+        verticalStep(rows - 1, scratch.data());
+    }
+
+    result.pairs.insert(result.pairs.end(), verticalPairs.begin(), verticalPairs.end());
+    verticalPairs.clear();
+    return result;
+}
+
+BitboardBandingDetector::Result BitboardBandingDetector::detect(const PaletteIndex &index, int width, int height,
+                                                                int subjectThreshold, bool collectPairs) {
+    PF_PROFILE_SCOPE("BitboardBandingDetector::detect");
+    const std::vector<bool> entries = subjectPalette(index, subjectThreshold);
+
+    BitboardBandingDetector detector(width, collectPairs);
+    std::vector<uint64_t> subjectBits((width + 63) / 64);
+
+    index.visitPlane([&](auto plane) {
+        for (int y = 0; y < height; ++y) {
+            const auto row = plane.subspan(static_cast<size_t>(y) * width, width);
+            subjectRow(row, entries, subjectBits);
+            detector.pushRow(row, subjectBits.data());
+        }
+    });
+
+    Result result = detector.finish();
+    MemoryStats::recordStage("bitboardDetect", MemoryStats::vectorBytes(result.pairs) +
+                                               MemoryStats::vectorBytes(result.rowPairCounts) +
+                                               MemoryStats::vectorBytes(result.columnPairCounts) +
+                                               MemoryStats::vectorBytes(subjectBits));
+    return result;
+}
+
+template<typename T>
+std::vector<BitboardBandingDetector::Pair> BitboardBandingDetector::detectRowPairs(
+    std::span<const T> plane, int width, int firstRow, int lastRow, const std::vector<bool> &subjectEntries) {
+    BitboardBandingDetector detector(width, true);
+    std::vector<uint64_t> subjectBits((width + 63) / 64);
+
+    for (int y = firstRow; y <= lastRow; ++y) {
+        const auto row = plane.subspan(static_cast<size_t>(y) * width, width);
+        subjectRow(row, subjectEntries, subjectBits);
+        detector.pushRow(row, subjectBits.data());
+    }
+
+    // The band's vertical pairs are cut off at its edges; only the horizontal ones are meaningful
+    std::vector<Pair> pairs;
+    for (Pair pair: detector.finish().pairs) {
+        if (!pair.horizontal) break;
+        pair.line += firstRow;
+        pairs.push_back(pair);
+    }
+    return pairs;
+}
+
+template std::vector<BitboardBandingDetector::Pair> BitboardBandingDetector::detectRowPairs<uint8_t>(
+    std::span<const uint8_t>, int, int, int, const std::vector<bool> &);
+template std::vector<BitboardBandingDetector::Pair> BitboardBandingDetector::detectRowPairs<uint16_t>(
+    std::span<const uint16_t>, int, int, int, const std::vector<bool> &);
+
+std::vector<bool> BitboardBandingDetector::subjectPalette(const PaletteIndex &index, int subjectThreshold) {
+    std::vector<bool> entries;
+    for (const Color &color: index.getPalette())
+        entries.push_back(PixelArtImage::isSubjectColor(color, subjectThreshold));
+    return entries;
+}
+
+size_t BitboardBandingDetector::memoryBytes() const {
+    return MemoryStats::vectorBytes(previousRow) + MemoryStats::vectorBytes(previousStarts) +
+           MemoryStats::vectorBytes(previousEnds) + MemoryStats::vectorBytes(previousSubject) +
+           MemoryStats::vectorBytes(previousVerticalStarts) + MemoryStats::vectorBytes(pending) +
+           MemoryStats::vectorBytes(pendingStartRow) + MemoryStats::vectorBytes(starts) +
+           MemoryStats::vectorBytes(ends) + MemoryStats::vectorBytes(differences) +
+           MemoryStats::vectorBytes(scratch) + MemoryStats::vectorBytes(result.pairs) +
+           MemoryStats::vectorBytes(result.rowPairCounts) + MemoryStats::vectorBytes(result.columnPairCounts) +
+           MemoryStats::vectorBytes(verticalPairs);
+}
+
+void BitboardBandingDetector::computeEnds(const std::vector<uint64_t> &runStarts,
+                                          std::vector<uint64_t> &runEnds) const {
+    // A run ends right before the next one starts, and at the end of the row
+    for (int w = 0; w < words; ++w) {
+        runEnds[w] = runStarts[w] >> 1;
+        if (w + 1 < words) runEnds[w] |= runStarts[w + 1] << 63;
+    }
+    if (width > 0) runEnds[(width - 1) / 64] |= uint64_t{1} << ((width - 1) % 64);
+}
+
+void BitboardBandingDetector::horizontalStep(int row, const uint64_t *subjectBits) {
+    int count = 0;
+    uint64_t carry = 0;
+    int openStart = -1;
+
+    for (int w = 0; w < words; ++w) {
+        const uint64_t bothEnd = previousEnds[w] & ends[w];
+        const uint64_t anyEnd = previousEnds[w] | ends[w];
+
+        // Both rows start a run of differing, subject colors, and the runs are not both one pixel long
+        const uint64_t candidates = previousStarts[w] & starts[w] & differences[w] &
+                                    previousSubject[w] & subjectBits[w] & ~bothEnd;
+
+        // Advance every candidate to the first run end of either row: (C + ~U) & U, carrying across words
+        const uint64_t sum = candidates + ~anyEnd;
+        const uint64_t withCarry = sum + carry;
+        carry = (sum < candidates || withCarry < sum) ? 1 : 0;
+        const uint64_t reached = withCarry & anyEnd;
+        const uint64_t pairEnds = reached & bothEnd;
+
+        count += std::popcount(pairEnds);
+
+        if (collectPairs) {
+            // Starts and reached ends alternate, so the k-th start belongs to the k-th reached end
+            uint64_t startBits = candidates;
+            uint64_t endBits = reached;
+            while (true) {
+                if (openStart < 0) {
+                    if (startBits == 0) break;
+                    openStart = w * 64 + std::countr_zero(startBits);
+                    startBits &= startBits - 1;
+                } else {
+                    if (endBits == 0) break;
+                    const int bit = std::countr_zero(endBits);
+                    endBits &= endBits - 1;
+                    if ((pairEnds >> bit) & 1)
+                        result.pairs.push_back({true, row - 1, openStart, w * 64 + bit});
+                    openStart = -1;
+                }
+            }
+        }
+    }
+
+    result.error += count;
+    if (collectPairs) result.rowPairCounts.push_back(count);
+}
+
+void BitboardBandingDetector::verticalStep(int row, const uint64_t *verticalEnds) {
+    // Bit x of every mask below describes columns x - 1 and x
+    uint64_t startCarry = 0, endCarry = 0, subjectCarry = 0;
+
+    for (int w = 0; w < words; ++w) {
+        const uint64_t verticalStarts = previousVerticalStarts[w];
+        const uint64_t ends = verticalEnds[w];
+        const uint64_t subject = previousSubject[w];
+
+        const uint64_t bothStart = verticalStarts & ((verticalStarts << 1) | startCarry);
+        const uint64_t bothEnd = ends & ((ends << 1) | endCarry);
+        const uint64_t anyEnd = ends | (ends << 1) | endCarry;
+        const uint64_t bothSubject = subject & ((subject << 1) | subjectCarry);
+        startCarry = verticalStarts >> 63;
+        endCarry = ends >> 63;
+        subjectCarry = subject >> 63;
+
+        // A run start of the row is a color change from the left neighbour (bit 0 is the row start)
+        uint64_t colorChanges = previousStarts[w];
+        if (w == 0) colorChanges &= ~uint64_t{1};
+
+        const uint64_t candidates = bothStart & colorChanges & bothSubject;
+        uint64_t completed = pending[w] & bothEnd;
+        pending[w] = (pending[w] | candidates) & ~anyEnd;
+
+        for (uint64_t opened = candidates & ~anyEnd; opened != 0; opened &= opened - 1)
+            pendingStartRow[w * 64 + std::countr_zero(opened)] = row;
+
+        result.error += std::popcount(completed);
+        for (; completed != 0; completed &= completed - 1) {
+            const int x = w * 64 + std::countr_zero(completed);
+            result.columnPairCounts[x - 1]++;
+            if (collectPairs)
+                verticalPairs.push_back({false, x - 1, pendingStartRow[x], row});
+        }
+    }
+}
@@ -0,0 +1,118 @@
+#include "../include/FrameSequence.h"
+#include "../include/Profiler.h"
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <opencv2/opencv.hpp>
+
+FrameSequence FrameSequence::fromFiles(std::vector<std::string> paths) {
+    FrameSequence sequence;
+    sequence.paths = std::move(paths);
+    return sequence;
+}
+
+FrameSequence FrameSequence::fromStrip(const std::string &path, int frameWidth) {
+    FrameSequence sequence;
+    if (!sequence.strip.loadFromFile(path)) return sequence;
+
+    const int width = sequence.strip.getWidth();
+    const int height = sequence.strip.getHeight();
+    if (frameWidth <= 0) frameWidth = height;
+    if (frameWidth <= 0 || width % frameWidth != 0) {
+        std::cerr << "Cannot split a " << width << "x" << height << " strip into frames " << frameWidth
+                << " pixels wide: " << path << std::endl;
+        return sequence;
+    }
+
+    sequence.stripPath = path;
+    sequence.frameWidth = frameWidth;
+    sequence.stripFrames = width / frameWidth;
+    return sequence;
+}
+
+int FrameSequence::getFrameCount() const {
+    return stripPath.empty() ? static_cast<int>(paths.size()) : stripFrames;
+}
+
+bool FrameSequence::loadFrame(int index, PixelArtImage &frame) const {
+    PF_PROFILE_SCOPE("FrameSequence::loadFrame");
+    if (index < 0 || index >= getFrameCount()) return false;
+    if (stripPath.empty()) return frame.loadFromFile(paths[index]);
+
+    const int height = strip.getHeight();
+    frame = PixelArtImage(frameWidth, height);
+    const int offset = index * frameWidth;
+    for (int y = 0; y < height; ++y)
+        for (int x = 0; x < frameWidth; ++x)
+            frame.setPixel({x, y}, strip.getPixel({offset + x, y}).color);
+    return true;
+}
+
+std::string FrameSequence::frameName(int index) const {
+    if (stripPath.empty()) return std::filesystem::path(paths[index]).filename().string();
+
+    char suffix[16];
+    std::snprintf(suffix, sizeof(suffix), "_%04d.png", index);
+    return std::filesystem::path(stripPath).stem().string() + suffix;
+}
+
+FrameSequence::FrameDiff FrameSequence::diff(const PixelArtImage &previous, const PixelArtImage &current) {
+    PF_PROFILE_SCOPE("FrameSequence::diff");
+    FrameDiff diff;
+    const int width = current.getWidth();
+    const int height = current.getHeight();
+    diff.rows.assign(height, false);
+    diff.columns.assign(width, false);
+    diff.mask = cv::Mat::zeros(height, width, CV_8UC1);
+
+    if (previous.getWidth() != width || previous.getHeight() != height) {
+        diff.resized = true;
+        return diff;
+    }
+
+    const std::vector<unsigned char> before = previous.getRGBAData();
+    const std::vector<unsigned char> after = current.getRGBAData();
+    const size_t stride = static_cast<size_t>(width) * 4;
+
+    for (int y = 0; y < height; ++y) {
+        // Most rows of an animation frame are unchanged; skip them with one comparison
+        const unsigned char *a = before.data() + y * stride;
+        const unsigned char *b = after.data() + y * stride;
+        if (std::memcmp(a, b, stride) == 0) continue;
+
+        auto *maskRow = diff.mask.ptr<uchar>(y);
+        for (int x = 0; x < width; ++x) {
+            if (std::memcmp(a + x * 4, b + x * 4, 4) == 0) continue;
+            maskRow[x] = 255;
+            diff.rows[y] = true;
+            diff.columns[x] = true;
+            ++diff.changedPixels;
+        }
+    }
+    return diff;
+}
+
+void FrameSequence::carryOver(const PixelArtImage &previousResult, const FrameDiff &diff, int margin,
+                              PixelArtImage &frame) {
+    PF_PROFILE_SCOPE("FrameSequence::carryOver");
+    if (diff.resized) return;
+
+    cv::Mat keepOut;
+    if (margin > 0) {
+        cv::Mat kernel = cv::getStructuringElement(cv::MORPH_RECT, cv::Size(2 * margin + 1, 2 * margin + 1));
+        cv::dilate(diff.mask, keepOut, kernel);
+    } else {
+        keepOut = diff.mask;
+    }
+
+    for (int y = 0; y < frame.getHeight(); ++y) {
+        const auto *keepOutRow = keepOut.ptr<uchar>(y);
+        for (int x = 0; x < frame.getWidth(); ++x) {
+            if (keepOutRow[x]) continue;
+            const Color corrected = previousResult.getPixel({x, y}).color;
+            if (frame.getPixel({x, y}).color != corrected)
+                frame.setPixel({x, y}, corrected);
+        }
+    }
+}
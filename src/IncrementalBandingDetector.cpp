@@ -0,0 +1,91 @@
+#include "../include/IncrementalBandingDetector.h"
+#include <algorithm>
+
+BitboardBandingDetector::Result IncrementalBandingDetector::update(const PixelArtImage &frame,
+                                                                   const FrameSequence::FrameDiff *diff) {
+    const PaletteIndex &index = frame.getPaletteIndex();
+    if (!index.isValid()) {
+        reset();
+        BitboardBandingDetector::Result result;
+        result.error = -1;
+        return result;
+    }
+
+    const int newWidth = frame.getWidth();
+    const int newHeight = frame.getHeight();
+    std::vector<bool> changedRows(newHeight, true);
+    std::vector<bool> changedColumns(newWidth, true);
+    if (diff && !diff->resized && newWidth == width && newHeight == height) {
+        changedRows = diff->rows;
+        changedColumns = diff->columns;
+    } else {
+        width = newWidth;
+        height = newHeight;
+        rowPairs.assign(std::max(height - 1, 0), {});
+        columnPairs.assign(std::max(width - 1, 0), {});
+    }
+
+    const std::vector<bool> subjectEntries = BitboardBandingDetector::subjectPalette(index, subjectThreshold);
+    scannedLines = 0;
+
+    index.visitPlane([&](auto plane) {
+        rescan(changedRows, rowPairs, [&](int first, int last) {
+            return BitboardBandingDetector::detectRowPairs(plane, width, first, last, subjectEntries);
+        });
+    });
+
+    // Column pairs are the row pairs of the transposed plane, which is only built when a column changed
+    if (std::ranges::any_of(changedColumns, [](bool changed) { return changed; }))
+        index.visitTransposedPlane([&](auto plane) {
+            rescan(changedColumns, columnPairs, [&](int first, int last) {
+                auto pairs = BitboardBandingDetector::detectRowPairs(plane, height, first, last, subjectEntries);
+                for (auto &pair: pairs) pair.horizontal = false;
+                return pairs;
+            });
+        });
+
+    BitboardBandingDetector::Result result;
+    result.rowPairCounts.reserve(rowPairs.size());
+    for (const auto &pairs: rowPairs) {
+        result.rowPairCounts.push_back(static_cast<int>(pairs.size()));
+        result.pairs.insert(result.pairs.end(), pairs.begin(), pairs.end());
+    }
+    result.columnPairCounts.reserve(columnPairs.size());
+    for (const auto &pairs: columnPairs) {
+        result.columnPairCounts.push_back(static_cast<int>(pairs.size()));
+        result.pairs.insert(result.pairs.end(), pairs.begin(), pairs.end());
+    }
+    result.error = static_cast<int>(result.pairs.size());
+    return result;
+}
+
+void IncrementalBandingDetector::reset() {
+    width = -1;
+    height = -1;
+    rowPairs.clear();
+    columnPairs.clear();
+}
+
+template<typename Scan>
+void IncrementalBandingDetector::rescan(const std::vector<bool> &changed,
+                                        std::vector<std::vector<BitboardBandingDetector::Pair> > &pairs,
+                                        Scan &&scan) {
+    const int count = static_cast<int>(pairs.size());
+    int line = 0;
+    while (line < count) {
+        if (!changed[line] && !changed[line + 1]) {
+            ++line;
+            continue;
+        }
+
+        // A band of consecutive dirty line pairs [first, last] covers lines first..last + 1
+        const int first = line;
+        while (line < count && (changed[line] || changed[line + 1])) ++line;
+        const int last = line - 1;
+
+        for (int i = first; i <= last; ++i) pairs[i].clear();
+        for (const auto &pair: scan(first, last + 1))
+            pairs[pair.line].push_back(pair);
+        scannedLines += last - first + 2;
+    }
+}
@@ -0,0 +1,104 @@
+#include "../include/MemoryStats.h"
+#include <algorithm>
+#include <cstdio>
+#include <map>
+#include <mutex>
+
+#if defined(__linux__)
+#include <fstream>
+#include <sys/resource.h>
+#include <unistd.h>
+#elif defined(__APPLE__)
+#include <mach/mach.h>
+#include <sys/resource.h>
+#endif
+
+namespace {
+    struct MemoryState {
+        std::mutex mutex;
+        std::map<std::string, MemoryStats::StageStats> stages;
+    };
+
+    MemoryState &state() {
+        static MemoryState instance;
+        return instance;
+    }
+}
+
+void MemoryStats::recordStage(const char *stage, size_t bytes) {
+    auto &s = state();
+    std::lock_guard lock(s.mutex);
+    auto &stats = s.stages[stage];
+    stats.name = stage;
+    stats.samples++;
+    stats.peakBytes = std::max(stats.peakBytes, bytes);
+    stats.lastBytes = bytes;
+}
+
+std::vector<MemoryStats::StageStats> MemoryStats::getStageStats() {
+    auto &s = state();
+    std::lock_guard lock(s.mutex);
+    std::vector<StageStats> stages;
+    for (const auto &[name, stats]: s.stages) stages.push_back(stats);
+    return stages;
+}
+
+void MemoryStats::clear() {
+    auto &s = state();
+    std::lock_guard lock(s.mutex);
+    s.stages.clear();
+}
+
+size_t MemoryStats::residentBytes() {
+#if defined(__linux__)
+    std::ifstream statm("/proc/self/statm");
+    size_t pages = 0, residentPages = 0;
+    if (!(statm >> pages >> residentPages)) return 0;
+    return residentPages * static_cast<size_t>(sysconf(_SC_PAGESIZE));
+#elif defined(__APPLE__)
+    mach_task_basic_info info{};
+    mach_msg_type_number_t count = MACH_TASK_BASIC_INFO_COUNT;
+    if (task_info(mach_task_self(), MACH_TASK_BASIC_INFO, reinterpret_cast<task_info_t>(&info), &count) != KERN_SUCCESS)
+        return 0;
+    return info.resident_size;
+#else
+    return 0;
+#endif
+}
+
+size_t MemoryStats::peakResidentBytes() {
+#if defined(__linux__) || defined(__APPLE__)
+    rusage usage{};
+    if (getrusage(RUSAGE_SELF, &usage) != 0) return 0;
+#if defined(__APPLE__)
+    return static_cast<size_t>(usage.ru_maxrss); // bytes on macOS
+#else
+    return static_cast<size_t>(usage.ru_maxrss) * 1024; // kilobytes on Linux
+#endif
+#else
+    return 0;
+#endif
+}
+
+size_t MemoryStats::total(const MemoryBreakdown &breakdown) {
+    size_t bytes = 0;
+    for (const auto &item: breakdown) bytes += item.bytes;
+    return bytes;
+}
+
+std::string MemoryStats::formatBytes(size_t bytes) {
+    const char *units[] = {"B", "KiB", "MiB", "GiB"};
+    double value = static_cast<double>(bytes);
+    int unit = 0;
+    while (value >= 1024.0 && unit < 3) {
+        value /= 1024.0;
+        ++unit;
+    }
+
+    char text[32];
+    if (unit == 0)
+        std::snprintf(text, sizeof(text), "%zu B", bytes);
+    else
+        std::snprintf(text, sizeof(text), "%.2f %s", value, units[unit]);
+    return text;
+}
@@ -0,0 +1,127 @@
+#include "../include/PaletteIndex.h"
+#include "../include/MemoryStats.h"
+#include "../include/Profiler.h"
+#include <algorithm>
+
+namespace {
+    // Transposes in square tiles so that both the reads and the writes of a tile stay in cache
+    template<typename T>
+    void transposeBlocked(const T *source, int width, int height, T *destination) {
+        constexpr int tile = 32;
+        for (int ty = 0; ty < height; ty += tile) {
+            const int yEnd = std::min(ty + tile, height);
+            for (int tx = 0; tx < width; tx += tile) {
+                const int xEnd = std::min(tx + tile, width);
+                for (int y = ty; y < yEnd; ++y)
+                    for (int x = tx; x < xEnd; ++x)
+                        destination[static_cast<size_t>(x) * height + y] = source[static_cast<size_t>(y) * width + x];
+            }
+        }
+    }
+}
+
+void PaletteIndex::reset(int width, int height, const Color &fill) {
+    this->width = width;
+    this->height = height;
+    valid = true;
+    wideIndices = false;
+    palette.assign({fill});
+    counts.assign({width * height});
+    lookup.clear();
+    lookup.emplace(fill, 0);
+    narrow.assign(static_cast<size_t>(width) * height, 0);
+    wide.clear();
+    invalidateTransposed();
+}
+
+bool PaletteIndex::assign(size_t index, const Color &color) {
+    if (!valid) return false;
+
+    const uint16_t previous = at(index);
+    if (palette[previous] == color) return true;
+
+    auto id = find(color);
+    if (!id) id = addColor(color);
+    if (!id) return false;
+
+    counts[previous]--;
+    counts[*id]++;
+    if (wideIndices)
+        wide.write()[index] = *id;
+    else
+        narrow.write()[index] = static_cast<uint8_t>(*id);
+
+    if (transposedValid) {
+        const size_t transposed = (index % width) * static_cast<size_t>(height) + index / width;
+        if (wideIndices)
+            transposedWide.write()[transposed] = *id;
+        else
+            transposedNarrow.write()[transposed] = static_cast<uint8_t>(*id);
+    }
+    return true;
+}
+
+std::optional<uint16_t> PaletteIndex::find(const Color &color) const {
+    auto it = lookup.find(color);
+    if (it == lookup.end()) return std::nullopt;
+    return it->second;
+}
+
+std::optional<uint16_t> PaletteIndex::addColor(const Color &color) {
+    if (palette.size() == MAX_COLORS) {
+        // Too many colors to index; drop the plane instead of keeping a stale one
+        valid = false;
+        palette.clear();
+        counts.clear();
+        lookup.clear();
+        narrow.clear();
+        wide.clear();
+        invalidateTransposed();
+        return std::nullopt;
+    }
+
+    if (!wideIndices && palette.size() == NARROW_COLORS) {
+        wide.assign(std::vector<uint16_t>(narrow.begin(), narrow.end()));
+        narrow = {};
+        wideIndices = true;
+        invalidateTransposed();
+    }
+
+    const auto id = static_cast<uint16_t>(palette.size());
+    palette.push_back(color);
+    counts.push_back(0);
+    lookup.emplace(color, id);
+    return id;
+}
+
+size_t PaletteIndex::memoryBytes() const {
+    // Hash nodes hold the entry and a next pointer; buckets are one pointer each
+    const size_t lookupBytes = lookup.size() * (sizeof(std::pair<const Color, uint16_t>) + sizeof(void *)) +
+                               lookup.bucket_count() * sizeof(void *);
+    return MemoryStats::vectorBytes(palette) + MemoryStats::vectorBytes(counts) + lookupBytes +
+           MemoryStats::vectorBytes(narrow.read()) + MemoryStats::vectorBytes(wide.read()) +
+           MemoryStats::vectorBytes(transposedNarrow.read()) + MemoryStats::vectorBytes(transposedWide.read());
+}
+
+void PaletteIndex::ensureTransposed() const {
+    std::lock_guard lock(transposeMutex.mutex);
+    if (transposedValid) return;
+
+    PF_PROFILE_SCOPE("PaletteIndex::transpose");
+    if (wideIndices) {
+        auto &transposed = transposedWide.write();
+        transposed.resize(wide.size());
+        transposeBlocked(wide.read().data(), width, height, transposed.data());
+    } else {
+        auto &transposed = transposedNarrow.write();
+        transposed.resize(narrow.size());
+        transposeBlocked(narrow.read().data(), width, height, transposed.data());
+    }
+    transposedValid = true;
+}
+
+void PaletteIndex::invalidateTransposed() {
+    transposedValid = false;
+    transposedNarrow.clear();
+    transposedWide.clear();
+}
@@ -3,7 +3,14 @@
 //
 
 #include "../include/PixelArtImage.h"
+#include "../include/Profiler.h"
+#include "../include/RunTable.h"
+#include "../include/TaskScheduler.h"
+#include <algorithm>
 #include <iostream>
+#include <iterator>
+#include <limits>
+#include <numeric>
 #include <ranges>
 #include <opencv2/core/mat.hpp>
 #include <utility>
@@ -14,10 +21,15 @@
 PixelArtImage::PixelArtImage(const int width, const int height)
     : width(width), height(height), pixels(width * height), processedPixels(width * height),
       debugPixels(width * height) {
+    rebuildPaletteIndex();
 }
 
 PixelArtImage::PixelArtImage(const PixelArtImage &other) = default;
 
+PixelArtImage::PixelArtImage(PixelArtImage &&other) noexcept : width(0), height(0) {
+    *this = std::move(other);
+}
+
 PixelArtImage &PixelArtImage::operator=(const PixelArtImage &other) {
     if (this == &other) return *this;
 
@@ -29,12 +41,57 @@ PixelArtImage &PixelArtImage::operator=(const PixelArtImage &other) {
     debugLines = other.debugLines;
     highlightedPixels = other.highlightedPixels;
     affectedSegments = other.affectedSegments;
+    affectedSegmentIds = other.affectedSegmentIds;
+    affectedSegmentBounds = other.affectedSegmentBounds;
     clusters = other.clusters;
+    selectedSegment = other.selectedSegment;
+    generator = other.generator;
+    drawnPath = other.drawnPath;
+    paletteIndex = other.paletteIndex;
+    error = other.error;
+    revision = std::max(revision, other.revision) + 1;
+    // Revisions are numbered per image, so a current mark is translated to this image's new revision
+    bandingRevision = other.bandingRevision == other.revision ? revision : 0;
+
+    return *this;
+}
+
+PixelArtImage &PixelArtImage::operator=(PixelArtImage &&other) noexcept {
+    if (this == &other) return *this;
+
+    width = std::exchange(other.width, 0);
+    height = std::exchange(other.height, 0);
+    pixels = std::move(other.pixels);
+    processedPixels = std::move(other.processedPixels);
+    debugPixels = std::move(other.debugPixels);
+    debugLines = std::move(other.debugLines);
+    highlightedPixels = std::move(other.highlightedPixels);
+    affectedSegments = std::move(other.affectedSegments);
+    affectedSegmentIds = std::move(other.affectedSegmentIds);
+    affectedSegmentBounds = std::move(other.affectedSegmentBounds);
+    clusters = std::move(other.clusters);
+    selectedSegment = std::move(other.selectedSegment);
+    generator = std::exchange(other.generator, std::nullopt);
+    drawnPath = std::move(other.drawnPath);
+    paletteIndex = std::move(other.paletteIndex);
+    error = std::exchange(other.error, 0);
+    revision = std::max(revision, other.revision) + 1;
+    // Revisions are numbered per image, so a current mark is translated to this image's new revision
+    bandingRevision = other.bandingRevision == other.revision ? revision : 0;
+
+    // The moved-from canvas is empty; leave its containers in a known state
+    other.debugLines.clear();
+    other.affectedSegmentBounds.clear();
+    other.selectedSegment.clear();
+    other.drawnPath.clear();
+    other.paletteIndex = PaletteIndex();
+    ++other.revision;
 
     return *this;
 }
 
 bool PixelArtImage::loadFromFile(const std::string &filepath) {
+    PF_PROFILE_SCOPE("loadFromFile");
     int w, h, channels;
     unsigned char *data = stbi_load(filepath.c_str(), &w, &h, &channels, 0);
 
@@ -45,30 +102,29 @@ bool PixelArtImage::loadFromFile(const std::string &filepath) {
 
     width = w;
     height = h;
-    pixels.resize(width * height);
-    clearProcessedPixels();
-    processedPixels.resize(width * height);
-    clearDebugPixels();
-    debugPixels.resize(width * height);
-    clearHighlightedPixels();
-    highlightedPixels.resize(width * height);
-    clusters = segmentClusters();
+    ++revision;
+    paletteIndex = PaletteIndex(); // rebuilt once the new pixels are in
+    pixels.write().resize(width * height);
+    processedPixels.assign(width * height, std::nullopt);
+    debugPixels.assign(width * height, std::nullopt);
+    highlightedPixels.assign(width * height, std::nullopt);
+    segmentClusters();
     selectedSegment.clear();
+    setAffectedSegments({});
     clearDrawnPath();
 
-    for (int y = 0; y < height; ++y) {
+    // Rows are converted in parallel; the palette index is invalid here and rebuilt below
+    std::vector<Pixel> &basePixels = pixels.write();
+    parallelFor(0, height, 64, [&](int y) {
         for (int x = 0; x < width; ++x) {
-            int pos = (y * width + x) * channels;
-
-            unsigned char r = data[pos];
-            unsigned char g = (channels > 1) ? data[pos + 1] : r;
-            unsigned char b = (channels > 2) ? data[pos + 2] : r;
-
-            setPixel(glm::ivec2(x, y), glm::u8vec3(r, g, b));
+            const int pos = (y * width + x) * channels;
+            basePixels[y * width + x] = Pixel{decodedColor(data + pos, channels), {x, y}};
         }
-    }
+    });
 
     stbi_image_free(data);
+    rebuildPaletteIndex();
+    MemoryStats::recordStage("load", MemoryStats::vectorBytes(pixels.read()) + paletteIndex.memoryBytes());
     return true;
 }
 
@@ -82,7 +138,11 @@ void PixelArtImage::fill(const Color &color) {
 
 void PixelArtImage::setPixel(Pos pos, Color color) {
     if (pos.x < 0 || pos.x >= width || pos.y < 0 || pos.y >= height) return;
-    pixels[pos.y * width + pos.x] = Pixel{{color.r, color.g, color.b}, {pos.x, pos.y}};
+    const int index = pos.y * width + pos.x;
+    Pixel &pixel = pixels.write()[index];
+    if (pixel.color != color) ++revision;
+    pixel = Pixel{{color.r, color.g, color.b}, {pos.x, pos.y}};
+    syncPaletteIndex(index);
 }
 
 void PixelArtImage::setPixels(const std::vector<Pixel>& pixels) {
@@ -108,6 +168,53 @@ Pixel PixelArtImage::getPixel(const Pos pos) const {
 }
 
 
+void PixelArtImage::rebuildPaletteIndex() {
+    const size_t count = static_cast<size_t>(width) * height;
+    if (pixels.size() != count || processedPixels.size() != count || debugPixels.size() != count) return;
+
+    paletteIndex.reset(width, height, count > 0 ? getPixel({0, 0}).color : Color{});
+    for (int y = 0; y < height; ++y) {
+        for (int x = 0; x < width; ++x) {
+            if (!paletteIndex.assign(y * width + x, getPixel({x, y}).color)) return;
+        }
+    }
+}
+
+void PixelArtImage::syncPaletteIndex(int index) {
+    // An overflowed index stays dropped until the next full rebuild
+    if (!paletteIndex.isValid()) return;
+    paletteIndex.assign(index, getPixel({index % width, index / width}).color);
+}
+
+namespace {
+    size_t segmentsBytes(const std::vector<std::vector<Pixel> > &segments) {
+        size_t bytes = MemoryStats::vectorBytes(segments);
+        for (const auto &segment: segments) bytes += MemoryStats::vectorBytes(segment);
+        return bytes;
+    }
+
+    size_t clustersBytes(const std::vector<std::vector<std::vector<Pixel> > > &clusters) {
+        size_t bytes = MemoryStats::vectorBytes(clusters);
+        for (const auto &cluster: clusters) bytes += segmentsBytes(cluster);
+        return bytes;
+    }
+}
+
+MemoryBreakdown PixelArtImage::getMemoryUsage() const {
+    return {
+        {"pixels", MemoryStats::vectorBytes(pixels.read())},
+        {"processedPixels", MemoryStats::vectorBytes(processedPixels.read())},
+        {"debugPixels", MemoryStats::vectorBytes(debugPixels.read())},
+        {"highlightedPixels", MemoryStats::vectorBytes(highlightedPixels.read())},
+        {"debugLines", MemoryStats::vectorBytes(debugLines)},
+        {"clusters", clustersBytes(clusters.read())},
+        {"affectedSegments", segmentsBytes(affectedSegments.read()) + MemoryStats::vectorBytes(affectedSegmentIds.read()) +
+                             MemoryStats::vectorBytes(affectedSegmentBounds)},
+        {"paths", MemoryStats::vectorBytes(selectedSegment) + MemoryStats::vectorBytes(drawnPath)},
+        {"paletteIndex", paletteIndex.memoryBytes()},
+    };
+}
+
 std::vector<unsigned char> PixelArtImage::getRGBAData() const {
     std::vector<unsigned char> rgba;
     rgba.reserve(width * height * 4);
@@ -127,7 +234,11 @@ std::vector<unsigned char> PixelArtImage::getRGBAData() const {
 
 void PixelArtImage::setProcessedPixel(Pos pos, Color color) {
     if (pos.x < 0 || pos.x >= width || pos.y < 0 || pos.y >= height) return;
-    processedPixels[pos.y * width + pos.x] = Pixel{{color.r, color.g, color.b}, {pos.x, pos.y}};
+    const int index = pos.y * width + pos.x;
+    auto &pixel = processedPixels.write()[index];
+    if (!pixel.has_value() || pixel->color != color) ++revision;
+    pixel = Pixel{{color.r, color.g, color.b}, {pos.x, pos.y}};
+    syncPaletteIndex(index);
 }
 
 void PixelArtImage::setProcessedPixels(const PixelArtImage &other) {
@@ -139,12 +250,20 @@ void PixelArtImage::setProcessedPixels(const PixelArtImage &other) {
 }
 
 void PixelArtImage::clearProcessedPixels() {
-    std::ranges::fill(processedPixels, std::nullopt);
+    if (std::ranges::any_of(processedPixels.read(), [](const auto &pixel) { return pixel.has_value(); })) {
+        ++revision;
+        processedPixels.assign(processedPixels.size(), std::nullopt);
+        rebuildPaletteIndex();
+    }
 }
 
 void PixelArtImage::setDebugPixel(Pos pos, Color color) {
     if (pos.x < 0 || pos.x >= width || pos.y < 0 || pos.y >= height) return;
-    debugPixels[pos.y * width + pos.x] = Pixel{{color.r, color.g, color.b}, {pos.x, pos.y}};
+    const int index = pos.y * width + pos.x;
+    auto &pixel = debugPixels.write()[index];
+    if (!pixel.has_value() || pixel->color != color) ++revision;
+    pixel = Pixel{{color.r, color.g, color.b}, {pos.x, pos.y}};
+    syncPaletteIndex(index);
 }
 
 void PixelArtImage::setDebugPixels(const PixelArtImage &other) {
@@ -156,7 +275,11 @@ void PixelArtImage::setDebugPixels(const PixelArtImage &other) {
 }
 
 void PixelArtImage::clearDebugPixels() {
-    std::ranges::fill(debugPixels, std::nullopt);
+    if (std::ranges::any_of(debugPixels.read(), [](const auto &pixel) { return pixel.has_value(); })) {
+        ++revision;
+        debugPixels.assign(debugPixels.size(), std::nullopt);
+        rebuildPaletteIndex();
+    }
 }
 
 void PixelArtImage::addDebugLine(glm::vec2 start, glm::vec2 end, Color color) {
@@ -201,6 +324,7 @@ void PixelArtImage::clearDebugLinesWithColor(const Color &color) {
  * @return True if the file was saved successfully, false otherwise.
  */
 bool PixelArtImage::saveToFile(const std::string &filepath) const {
+    PF_PROFILE_SCOPE("saveToFile");
     std::vector<unsigned char> rgba = getRGBAData();
     std::vector<std::tuple<glm::vec2, glm::vec2, Color>> debugLines = getDebugLines();
 
@@ -307,20 +431,32 @@ bool PixelArtImage::saveToFile(const std::string &filepath) const {
 
 
 std::vector<std::vector<std::vector<Pixel> > > PixelArtImage::segmentClusters(bool horizontalOrientation) {
-    clearClusters();
+    PF_PROFILE_SCOPE("segmentClusters");
+    auto computed = computeClusters(horizontalOrientation);
+    clusters.assign(computed);
+    return computed;
+}
+
+template<typename O>
+std::vector<std::vector<std::vector<Pixel> > > PixelArtImage::computeClusters() const {
+    if (paletteIndex.isValid())
+        return segmentClustersFromRuns<O>();
+
     std::vector<bool> visited(width * height, false);
 
-    cv::Mat mask = extractSubject(*this);
+    // Without a palette index, fall back to the subject mask and color comparisons
+    const cv::Mat mask = extractSubject(*this);
+    auto isSubject = [&](int x, int y) { return mask.at<uchar>(y, x) == 255; };
+    auto sameColor = [&](Pos a, Pos b) { return getPixel(a).color == getPixel(b).color; };
 
     std::vector<std::vector<std::vector<Pixel> > > clusteredSegments;
 
     for (int y = 0; y < height; ++y) {
         for (int x = 0; x < width; ++x) {
-            if (mask.at<uchar>(y, x) != 255) continue;
+            if (!isSubject(x, y)) continue;
 
             Pos pos(x, y);
             if (!visited[y * width + x]) {
-                Color clusterColor = getPixel(pos).color;
                 std::vector<Pixel> fullCluster;
                 std::stack<Pos> stack;
                 stack.push(pos);
@@ -336,9 +472,9 @@ std::vector<std::vector<std::vector<Pixel> > > PixelArtImage::segmentClusters(bo
 
                         if (neighbor.x >= 0 && neighbor.x < width &&
                             neighbor.y >= 0 && neighbor.y < height &&
-                            mask.at<uchar>(neighbor.y, neighbor.x) == 255 &&
+                            isSubject(neighbor.x, neighbor.y) &&
                             !visited[neighbor.y * width + neighbor.x] &&
-                            getPixel(neighbor).color == clusterColor) {
+                            sameColor(neighbor, pos)) {
                             visited[neighbor.y * width + neighbor.x] = true;
                             stack.push(neighbor);
                         }
@@ -348,24 +484,21 @@ std::vector<std::vector<std::vector<Pixel> > > PixelArtImage::segmentClusters(bo
                 // Segment fullCluster by rows or columns into segments
                 std::unordered_map<int, std::vector<Pixel> > lines;
                 for (const auto &pixel: fullCluster) {
-                    int key = horizontalOrientation ? pixel.pos.y : pixel.pos.x;
-                    lines[key].push_back(pixel);
+                    lines[O::line(pixel.pos)].push_back(pixel);
                 }
 
                 std::vector<std::vector<Pixel> > segmentsInCluster;
 
                 for (auto &linePixels: lines | std::views::values) {
-                    std::ranges::sort(linePixels, [&](const Pixel &a, const Pixel &b) {
-                        return horizontalOrientation ? a.pos.x < b.pos.x : a.pos.y < b.pos.y;
-                    });
+                    std::ranges::sort(linePixels, {}, [](const Pixel &p) { return O::along(p.pos); });
 
                     std::vector<Pixel> segment;
                     for (auto & i : linePixels) {
                         if (segment.empty()) {
                             segment.push_back(i);
                         } else {
-                            int prevCoord = horizontalOrientation ? segment.back().pos.x : segment.back().pos.y;
-                            int currCoord = horizontalOrientation ? i.pos.x : i.pos.y;
+                            int prevCoord = O::along(segment.back().pos);
+                            int currCoord = O::along(i.pos);
 
                             if (currCoord == prevCoord + 1) {
                                 segment.push_back(i);
@@ -383,23 +516,126 @@ std::vector<std::vector<std::vector<Pixel> > > PixelArtImage::segmentClusters(bo
                 }
 
                 if (!segmentsInCluster.empty()) {
-                    clusters.push_back(segmentsInCluster);
+                    clusteredSegments.push_back(segmentsInCluster);
                 }
             }
         }
     }
 
-    return clusters;
+    MemoryStats::recordStage("segmentClusters", clustersBytes(clusteredSegments) + visited.capacity() / 8);
+    return clusteredSegments;
+}
+
+
+template<typename O>
+std::vector<std::vector<std::vector<Pixel> > > PixelArtImage::segmentClustersFromRuns() const {
+    // Vertical runs are the row runs of the transposed plane, so both orientations share the row kernels.
+    // Below, a "line" is a row (or a column) and positions along it are x (or y).
+    const int lines = O::IS_HORIZONTAL ? height : width;
+    const RunTable table = [&] {
+        if constexpr (O::IS_HORIZONTAL)
+            return RunTable::build(paletteIndex, width, height);
+        else
+            return paletteIndex.visitTransposedPlane([&](auto plane) { return RunTable::build(plane, height, width); });
+    }();
+    const auto &runs = table.getRuns();
+
+    std::vector<bool> subjectEntries;
+    for (const Color &color: paletteIndex.getPalette())
+        subjectEntries.push_back(isSubjectColor(color));
+
+    // Union-find over runs: overlapping subject runs of neighbouring lines with the same index form one cluster.
+    // Unions keep the smaller run index as root, i.e. each cluster's first run in line order.
+    std::vector<int> parent(runs.size());
+    std::iota(parent.begin(), parent.end(), 0);
+    auto find = [&](int r) {
+        while (parent[r] != r) {
+            parent[r] = parent[parent[r]];
+            r = parent[r];
+        }
+        return r;
+    };
+
+    for (int line = 1; line < lines; ++line) {
+        int a = table.rowBegin(line - 1);
+        const int aEnd = table.rowBegin(line);
+        int b = aEnd;
+        const int bEnd = table.rowBegin(line + 1);
+
+        while (a < aEnd && b < bEnd) {
+            const auto &previous = runs[a];
+            const auto &current = runs[b];
+            if (previous.id == current.id && subjectEntries[previous.id] &&
+                previous.start <= current.end && current.start <= previous.end) {
+                const int rootA = find(a);
+                const int rootB = find(b);
+                if (rootA != rootB) parent[std::max(rootA, rootB)] = std::min(rootA, rootB);
+            }
+            if (previous.end < current.end) ++a; else ++b;
+        }
+    }
+
+    std::vector<std::vector<std::vector<Pixel> > > clusteredSegments;
+    std::vector<int> clusterOf(runs.size(), -1);
+    std::vector<int> firstPixel; // raster index of each cluster's first pixel
+    for (int line = 0; line < lines; ++line) {
+        for (int r = table.rowBegin(line); r < table.rowBegin(line + 1); ++r) {
+            const auto &run = runs[r];
+            if (!subjectEntries[run.id]) continue;
+
+            const int root = find(r);
+            if (clusterOf[root] < 0) {
+                clusterOf[root] = static_cast<int>(clusteredSegments.size());
+                clusteredSegments.emplace_back();
+                firstPixel.push_back(std::numeric_limits<int>::max());
+            }
+
+            const int cluster = clusterOf[root];
+            const Pos first = O::at(line, run.start);
+            firstPixel[cluster] = std::min(firstPixel[cluster], first.y * width + first.x);
+
+            const Color color = paletteIndex.getColor(run.id);
+            std::vector<Pixel> segment;
+            segment.reserve(run.length());
+            for (int i = run.start; i <= run.end; ++i)
+                segment.push_back(Pixel{color, O::at(line, i)});
+            clusteredSegments[cluster].push_back(std::move(segment));
+        }
+    }
+
+    // Clusters appear in the raster order of their first pixel, as with the flood fill
+    if constexpr (!O::IS_HORIZONTAL) {
+        std::vector<int> order(clusteredSegments.size());
+        std::iota(order.begin(), order.end(), 0);
+        std::ranges::sort(order, {}, [&](int cluster) { return firstPixel[cluster]; });
+
+        std::vector<std::vector<std::vector<Pixel> > > sorted;
+        sorted.reserve(clusteredSegments.size());
+        for (int cluster: order)
+            sorted.push_back(std::move(clusteredSegments[cluster]));
+        clusteredSegments = std::move(sorted);
+    }
+
+    MemoryStats::recordStage("segmentClusters", clustersBytes(clusteredSegments) + MemoryStats::vectorBytes(table.getRuns()));
+    return clusteredSegments;
+}
+
+template std::vector<std::vector<std::vector<Pixel> > > PixelArtImage::computeClusters<Horizontal>() const;
+template std::vector<std::vector<std::vector<Pixel> > > PixelArtImage::computeClusters<Vertical>() const;
+
+std::vector<std::vector<std::vector<Pixel> > > PixelArtImage::computeClusters(bool horizontalOrientation) const {
+    return withOrientation(horizontalOrientation, [this]<typename O>(O) { return computeClusters<O>(); });
 }
 
 
 void PixelArtImage::clearHighlightedPixels() {
-    std::ranges::fill(highlightedPixels, std::nullopt);
+    if (std::ranges::any_of(highlightedPixels.read(), [](const auto &pixel) { return pixel.has_value(); }))
+        highlightedPixels.assign(highlightedPixels.size(), std::nullopt);
 }
 
 void PixelArtImage::setHighlightedPixel(Pos pos, Color color) {
     if (pos.x < 0 || pos.x >= width || pos.y < 0 || pos.y >= height) return;
-    highlightedPixels[pos.y * width + pos.x] = Pixel{{color.r, color.g, color.b}, {pos.x, pos.y}};
+    highlightedPixels.write()[pos.y * width + pos.x] = Pixel{{color.r, color.g, color.b}, {pos.x, pos.y}};
 }
 
 void PixelArtImage::setHighlightedPixels(const std::vector<Pos> &cluster, Color color) {
@@ -409,11 +645,11 @@ void PixelArtImage::setHighlightedPixels(const std::vector<Pos> &cluster, Color
 }
 
 const std::vector<std::optional<Pixel> > &PixelArtImage::getHighlightedPixels() const {
-    return highlightedPixels;
+    return highlightedPixels.read();
 }
 
 [[nodiscard]] const std::vector<std::vector<std::vector<Pixel> > > &PixelArtImage::getClusters() const {
-    return clusters;
+    return clusters.read();
 }
 
 void PixelArtImage::clearClusters() {
@@ -428,12 +664,110 @@ void PixelArtImage::clearSelectedSegment() {
     selectedSegment.clear();
 }
 
-std::vector<std::vector<Pixel>> PixelArtImage::getAffectedSegments() const {
-    return affectedSegments;
+const std::vector<std::vector<Pixel>> &PixelArtImage::getAffectedSegments() const {
+    return affectedSegments.read();
 }
 
 void PixelArtImage::setAffectedSegments(std::vector<std::vector<Pixel>> affectedSegs) {
-    affectedSegments = std::move(affectedSegs);
+    affectedSegments.assign(std::move(affectedSegs));
+
+    affectedSegmentIds.assign(width * height, -1);
+    std::vector<int> &ids = affectedSegmentIds.write();
+    affectedSegmentBounds.clear();
+    affectedSegmentBounds.reserve(affectedSegments.size());
+
+    for (size_t id = 0; id < affectedSegments.size(); ++id) {
+        Pos minPos(std::numeric_limits<int>::max());
+        Pos maxPos(std::numeric_limits<int>::min());
+
+        for (const auto &pixel: affectedSegments[id]) {
+            minPos = glm::min(minPos, pixel.pos);
+            maxPos = glm::max(maxPos, pixel.pos);
+
+            if (pixel.pos.x >= 0 && pixel.pos.x < width && pixel.pos.y >= 0 && pixel.pos.y < height)
+                ids[pixel.pos.y * width + pixel.pos.x] = static_cast<int>(id);
+        }
+
+        affectedSegmentBounds.emplace_back(minPos, maxPos);
+    }
+}
+
+void PixelArtImage::updateAffectedSegments(const std::vector<int> &removed, std::vector<std::vector<Pixel>> added) {
+    if (affectedSegmentIds.size() != static_cast<size_t>(width * height)) {
+        std::vector<std::vector<Pixel>> segments;
+        for (size_t id = 0; id < affectedSegments.size(); ++id)
+            if (std::ranges::find(removed, static_cast<int>(id)) == removed.end())
+                segments.push_back(affectedSegments[id]);
+        std::ranges::move(added, std::back_inserter(segments));
+        setAffectedSegments(std::move(segments));
+        return;
+    }
+
+    auto inside = [&](const Pos &pos) { return pos.x >= 0 && pos.x < width && pos.y >= 0 && pos.y < height; };
+
+    std::vector<std::vector<Pixel>> &segments = affectedSegments.write();
+    std::vector<int> &ids = affectedSegmentIds.write();
+    std::vector<bool> dropped(segments.size(), false);
+    for (int id: removed) dropped[id] = true;
+
+    // Segments from the first dropped one on are dropped or renumbered: clear the cells they own
+    const auto first = static_cast<size_t>(std::ranges::find(dropped, true) - dropped.begin());
+    for (size_t id = first; id < segments.size(); ++id)
+        for (const auto &pixel: segments[id])
+            if (inside(pixel.pos) && ids[pixel.pos.y * width + pixel.pos.x] == static_cast<int>(id))
+                ids[pixel.pos.y * width + pixel.pos.x] = -1;
+
+    std::vector<Pixel> droppedPixels;
+    size_t kept = first;
+    for (size_t id = first; id < segments.size(); ++id) {
+        if (dropped[id]) {
+            droppedPixels.insert(droppedPixels.end(), segments[id].begin(), segments[id].end());
+            continue;
+        }
+        segments[kept] = std::move(segments[id]);
+        affectedSegmentBounds[kept] = affectedSegmentBounds[id];
+        ++kept;
+    }
+    segments.resize(kept);
+    affectedSegmentBounds.resize(kept);
+
+    for (auto &segment: added) {
+        Pos minPos(std::numeric_limits<int>::max());
+        Pos maxPos(std::numeric_limits<int>::min());
+        for (const auto &pixel: segment) {
+            minPos = glm::min(minPos, pixel.pos);
+            maxPos = glm::max(maxPos, pixel.pos);
+        }
+        segments.push_back(std::move(segment));
+        affectedSegmentBounds.emplace_back(minPos, maxPos);
+    }
+
+    for (size_t id = first; id < segments.size(); ++id)
+        for (const auto &pixel: segments[id])
+            if (inside(pixel.pos)) ids[pixel.pos.y * width + pixel.pos.x] = static_cast<int>(id);
+
+    // A dropped segment may have covered a crossing with an earlier segment; segments are straight runs,
+    // so a bounding box that contains the pixel means the segment does
+    for (const auto &pixel: droppedPixels) {
+        if (!inside(pixel.pos) || ids[pixel.pos.y * width + pixel.pos.x] != -1) continue;
+        for (size_t id = first; id-- > 0;) {
+            const auto &[minPos, maxPos] = affectedSegmentBounds[id];
+            if (pixel.pos.x >= minPos.x && pixel.pos.x <= maxPos.x && pixel.pos.y >= minPos.y && pixel.pos.y <= maxPos.y) {
+                ids[pixel.pos.y * width + pixel.pos.x] = static_cast<int>(id);
+                break;
+            }
+        }
+    }
+}
+
+int PixelArtImage::getAffectedSegmentAt(Pos pos) const {
+    if (pos.x < 0 || pos.x >= width || pos.y < 0 || pos.y >= height) return -1;
+    if (affectedSegmentIds.size() != static_cast<size_t>(width * height)) return -1;
+    return affectedSegmentIds[pos.y * width + pos.x];
+}
+
+std::pair<Pos, Pos> PixelArtImage::getAffectedSegmentBounds(int id) const {
+    return affectedSegmentBounds[id];
 }
 
 void PixelArtImage::setSelectedSegment(const std::vector<Pixel> &segment) {
@@ -449,23 +783,40 @@ int PixelArtImage::getError() const {
     return error;
 }
 
-cv::Mat PixelArtImage::extractSubject(const PixelArtImage &canvas) {
-    int width = canvas.getWidth();
-    int height = canvas.getHeight();
+cv::Mat PixelArtImage::extractSubject(const PixelArtImage &canvas, int threshold) {
+    return analyzeSubject(canvas, threshold).mask;
+}
 
-    cv::Mat mask(height, width, CV_8UC1, cv::Scalar(0));
+SubjectMask PixelArtImage::analyzeSubject(const PixelArtImage &canvas, int threshold) {
+    const int width = canvas.getWidth();
+    const std::vector<Pixel> &base = canvas.pixels.read();
+    const std::vector<std::optional<Pixel> > &processed = canvas.processedPixels.read();
+    const std::vector<std::optional<Pixel> > &debug = canvas.debugPixels.read();
 
-    constexpr int threshold = 254; // tolerance for "near-white"
-    for (int y = 0; y < height; ++y) {
+    // Pack one RGBA row at a time straight from the layers, topmost layer first as in getPixel;
+    // RGBA rather than RGB because that is the layout the x86 row kernel vectorizes
+    std::vector<uint8_t> packed(static_cast<size_t>(width) * 4, 255);
+    return SubjectMask::compute(width, canvas.getHeight(), 4, threshold, [&](int y) {
+        const size_t rowStart = static_cast<size_t>(y) * width;
         for (int x = 0; x < width; ++x) {
-            Color color = canvas.getPixel({x, y}).color;
-            if (color.r < threshold || color.g < threshold || color.b < threshold) {
-                mask.at<uchar>(y, x) = 255;
-            }
+            const size_t index = rowStart + x;
+            const Color &color = debug[index].has_value()
+                                     ? debug[index]->color
+                                     : processed[index].has_value() ? processed[index]->color : base[index].color;
+            packed[x * 4] = color.r;
+            packed[x * 4 + 1] = color.g;
+            packed[x * 4 + 2] = color.b;
         }
-    }
+        return packed.data();
+    });
+}
+
+bool PixelArtImage::isSubjectColor(const Color &color, int threshold) {
+    return color.r < threshold || color.g < threshold || color.b < threshold;
+}
 
-    return mask;
+Color PixelArtImage::decodedColor(const unsigned char *pixel, int channels) {
+    return {pixel[0], channels > 1 ? pixel[1] : pixel[0], channels > 2 ? pixel[2] : pixel[0]};
 }
 
 std::optional<Pixel> PixelArtImage::getGenerator() const {
@@ -0,0 +1,182 @@
+#include "../include/Profiler.h"
+#include <algorithm>
+#include <fstream>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <unordered_map>
+
+namespace {
+    using Clock = std::chrono::steady_clock;
+
+    // Keeps long GUI sessions from growing the trace without bound
+    constexpr size_t kMaxTraceEvents = 1 << 20;
+
+    struct TraceEvent {
+        const char *name;
+        int threadIndex;
+        long long startUs;
+        long long durationUs;
+    };
+
+    struct Aggregate {
+        std::vector<Profiler::ZoneStats> zones;
+        std::unordered_map<std::string, size_t> indexByPath;
+
+        void add(const std::string &path, const char *name, int depth, double ms) {
+            auto [it, inserted] = indexByPath.try_emplace(path, zones.size());
+            if (inserted)
+                zones.push_back({path, name, depth, 0, 0.0});
+            auto &zone = zones[it->second];
+            zone.calls++;
+            zone.totalMs += ms;
+        }
+
+        [[nodiscard]] std::vector<Profiler::ZoneStats> sorted() const {
+            auto result = zones;
+            std::ranges::sort(result, {}, &Profiler::ZoneStats::path);
+            return result;
+        }
+
+        void clear() {
+            zones.clear();
+            indexByPath.clear();
+        }
+    };
+
+    struct ProfilerState {
+        std::mutex mutex;
+        Clock::time_point origin = Clock::now();
+        std::vector<TraceEvent> trace;
+        std::unordered_map<std::thread::id, int> threadIndices;
+        std::optional<std::thread::id> frameThread;
+        Aggregate currentFrame;
+        std::vector<Profiler::ZoneStats> lastFrame;
+        Aggregate run;
+        bool runActive = false;
+    };
+
+    ProfilerState &state() {
+        static ProfilerState instance;
+        return instance;
+    }
+
+    thread_local std::vector<const char *> zoneStack;
+
+    std::string escapeJson(const char *text) {
+        std::string escaped;
+        for (const char *c = text; *c != '\0'; ++c) {
+            if (*c == '"' || *c == '\\') escaped.push_back('\\');
+            escaped.push_back(*c);
+        }
+        return escaped;
+    }
+}
+
+void Profiler::beginFrame() {
+    auto &s = state();
+    std::lock_guard lock(s.mutex);
+    s.frameThread = std::this_thread::get_id();
+    s.lastFrame = s.currentFrame.sorted();
+    s.currentFrame.clear();
+}
+
+void Profiler::beginRun() {
+    auto &s = state();
+    std::lock_guard lock(s.mutex);
+    s.run.clear();
+    s.runActive = true;
+}
+
+void Profiler::endRun() {
+    auto &s = state();
+    std::lock_guard lock(s.mutex);
+    s.runActive = false;
+}
+
+std::vector<Profiler::ZoneStats> Profiler::getFrameStats() {
+    auto &s = state();
+    std::lock_guard lock(s.mutex);
+    return s.lastFrame;
+}
+
+std::vector<Profiler::ZoneStats> Profiler::getRunStats() {
+    auto &s = state();
+    std::lock_guard lock(s.mutex);
+    return s.run.sorted();
+}
+
+bool Profiler::exportChromeTrace(const std::string &filepath) {
+    std::vector<TraceEvent> events;
+    {
+        auto &s = state();
+        std::lock_guard lock(s.mutex);
+        events = s.trace;
+    }
+
+    std::ofstream out(filepath);
+    if (!out) return false;
+
+    out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+    for (size_t i = 0; i < events.size(); ++i) {
+        const auto &e = events[i];
+        if (i > 0) out << ',';
+        out << "\n{\"name\":\"" << escapeJson(e.name) << "\",\"cat\":\"pixelfixer\",\"ph\":\"X\""
+            << ",\"ts\":" << e.startUs << ",\"dur\":" << e.durationUs
+            << ",\"pid\":1,\"tid\":" << e.threadIndex << '}';
+    }
+    out << "\n]}\n";
+
+    return static_cast<bool>(out);
+}
+
+void Profiler::clear() {
+    auto &s = state();
+    std::lock_guard lock(s.mutex);
+    s.trace.clear();
+    s.currentFrame.clear();
+    s.lastFrame.clear();
+    s.run.clear();
+}
+
+void Profiler::record(const std::string &path, const char *name, int depth,
+                      Clock::time_point start, Clock::time_point end) {
+    const double ms = std::chrono::duration<double, std::milli>(end - start).count();
+    const auto threadId = std::this_thread::get_id();
+
+    auto &s = state();
+    std::lock_guard lock(s.mutex);
+
+    auto [it, _] = s.threadIndices.try_emplace(threadId, static_cast<int>(s.threadIndices.size()));
+    if (s.trace.size() < kMaxTraceEvents) {
+        s.trace.push_back({
+            name, it->second,
+            std::chrono::duration_cast<std::chrono::microseconds>(start - s.origin).count(),
+            std::chrono::duration_cast<std::chrono::microseconds>(end - start).count()
+        });
+    }
+
+    const bool onFrameThread = s.frameThread.has_value() && *s.frameThread == threadId;
+    if (onFrameThread)
+        s.currentFrame.add(path, name, depth, ms);
+    else if (s.runActive || !s.frameThread.has_value())
+        s.run.add(path, name, depth, ms);
+}
+
+ProfileZone::ProfileZone(const char *name) : name(name), start(std::chrono::steady_clock::now()) {
+    zoneStack.push_back(name);
+}
+
+ProfileZone::~ProfileZone() {
+    const auto end = std::chrono::steady_clock::now();
+
+    std::string path;
+    for (const char *zone: zoneStack) {
+        if (!path.empty()) path.push_back('/');
+        path += zone;
+    }
+    const int depth = static_cast<int>(zoneStack.size()) - 1;
+    zoneStack.pop_back();
+
+    Profiler::record(path, name, depth, start, end);
+}
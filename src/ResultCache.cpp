@@ -0,0 +1,208 @@
+#include "../include/ResultCache.h"
+#include "../include/Profiler.h"
+#include <algorithm>
+#include <bit>
+#include <cstdio>
+#include <fstream>
+#include <functional>
+#include <random>
+#include <thread>
+#include <vector>
+
+namespace {
+    constexpr const char *IMAGE_EXTENSION = ".png";
+    constexpr const char *REPORT_EXTENSION = ".report";
+
+    /**
+     * Two independent 64-bit lanes: byte-wise FNV-1a and a word-wise multiply-rotate hash.
+     * 128 bits keep accidental collisions out of reach for any realistic asset library.
+     */
+    class KeyHasher {
+    public:
+        void bytes(const void *data, size_t size) {
+            const auto *p = static_cast<const unsigned char *>(data);
+            for (size_t i = 0; i < size; ++i) {
+                fnv = (fnv ^ p[i]) * 0x100000001b3ULL;
+                word |= static_cast<uint64_t>(p[i]) << (8 * wordBytes);
+                if (++wordBytes == 8) flushWord();
+            }
+        }
+
+        void string(const std::string &text) {
+            value(text.size());
+            bytes(text.data(), text.size());
+        }
+
+        template<typename T>
+        void value(const T &v) {
+            bytes(&v, sizeof(v));
+        }
+
+        std::string hex() {
+            if (wordBytes > 0) flushWord();
+            char out[33];
+            std::snprintf(out, sizeof(out), "%016llx%016llx", static_cast<unsigned long long>(finalize(fnv)),
+                          static_cast<unsigned long long>(finalize(mix)));
+            return out;
+        }
+
+    private:
+        uint64_t fnv = 0xcbf29ce484222325ULL;
+        uint64_t mix = 0x9e3779b97f4a7c15ULL;
+        uint64_t word = 0;
+        int wordBytes = 0;
+
+        void flushWord() {
+            mix = std::rotl(mix ^ (word * 0x87c37b91114253d5ULL), 31) * 0x4cf5ad432745937fULL;
+            word = 0;
+            wordBytes = 0;
+        }
+
+        static uint64_t finalize(uint64_t h) {
+            h ^= h >> 33;
+            h *= 0xff51afd7ed558ccdULL;
+            h ^= h >> 33;
+            h *= 0xc4ceb9fe1a85ec53ULL;
+            return h ^ (h >> 33);
+        }
+    };
+
+    void hashPixels(KeyHasher &hasher, const std::vector<Pixel> &pixels) {
+        hasher.value(pixels.size());
+        for (const Pixel &pixel: pixels) {
+            hasher.value(pixel.pos.x);
+            hasher.value(pixel.pos.y);
+        }
+    }
+}
+
+ResultCache::ResultCache(std::filesystem::path directory, std::uintmax_t capacityBytes)
+    : directory(std::move(directory)), capacity(capacityBytes) {
+    std::error_code error;
+    std::filesystem::create_directories(this->directory, error);
+    valid = !error && std::filesystem::is_directory(this->directory, error);
+}
+
+std::string ResultCache::key(const PixelArtImage &input, const Algorithm &algorithm) {
+    PF_PROFILE_SCOPE("ResultCache::key");
+    KeyHasher hasher;
+    hasher.string(TOOL_VERSION);
+    hasher.string(algorithm.name());
+    hasher.string(algorithm.parameters());
+
+    hasher.value(input.getWidth());
+    hasher.value(input.getHeight());
+    const std::vector<unsigned char> rgba = input.getRGBAData();
+    hasher.bytes(rgba.data(), rgba.size());
+
+    const auto generator = input.getGenerator();
+    hasher.value(generator.has_value());
+    if (generator) {
+        hasher.value(generator->pos.x);
+        hasher.value(generator->pos.y);
+    }
+    hashPixels(hasher, input.getDrawnPath());
+    hashPixels(hasher, input.getSelectedSegment());
+
+    return hasher.hex();
+}
+
+std::optional<ResultCache::Entry> ResultCache::find(const std::string &key) const {
+    if (!valid) return std::nullopt;
+
+    const auto report = directory / (key + REPORT_EXTENSION);
+    const auto image = directory / (key + IMAGE_EXTENSION);
+
+    std::ifstream in(report);
+    std::string version;
+    Entry entry{image, 0};
+    if (!(in >> version >> entry.bandingError) || version != TOOL_VERSION) return std::nullopt;
+
+    std::error_code error;
+    if (!std::filesystem::is_regular_file(image, error)) return std::nullopt;
+
+    // The report's time stamp is the entry's last use
+    std::filesystem::last_write_time(report, std::filesystem::file_time_type::clock::now(), error);
+    return entry;
+}
+
+bool ResultCache::store(const std::string &key, const PixelArtImage &result, int bandingError) const {
+    PF_PROFILE_SCOPE("ResultCache::store");
+    if (!valid) return false;
+
+    std::error_code error;
+    const auto imageTemporary = temporaryPath(key + IMAGE_EXTENSION);
+    if (!result.saveToFile(imageTemporary.string())) {
+        std::filesystem::remove(imageTemporary, error);
+        return false;
+    }
+    std::filesystem::rename(imageTemporary, directory / (key + IMAGE_EXTENSION), error);
+    if (error) {
+        std::filesystem::remove(imageTemporary, error);
+        return false;
+    }
+
+    const auto reportTemporary = temporaryPath(key + REPORT_EXTENSION);
+    {
+        std::ofstream out(reportTemporary);
+        out << TOOL_VERSION << ' ' << bandingError << '\n';
+        if (!out) {
+            out.close();
+            std::filesystem::remove(reportTemporary, error);
+            return false;
+        }
+    }
+    std::filesystem::rename(reportTemporary, directory / (key + REPORT_EXTENSION), error);
+    if (error) {
+        std::filesystem::remove(reportTemporary, error);
+        return false;
+    }
+
+    evict();
+    return true;
+}
+
+std::filesystem::path ResultCache::temporaryPath(const std::string &name) const {
+    // Unique per process and thread, so concurrent writers never share a file
+    thread_local std::mt19937_64 random{
+        std::random_device{}() ^ std::hash<std::thread::id>{}(std::this_thread::get_id())
+    };
+    char suffix[32];
+    std::snprintf(suffix, sizeof(suffix), ".tmp-%016llx", static_cast<unsigned long long>(random()));
+    return directory / (name + suffix);
+}
+
+void ResultCache::evict() const {
+    PF_PROFILE_SCOPE("ResultCache::evict");
+    struct Stored {
+        std::filesystem::path report;
+        std::filesystem::path image;
+        std::filesystem::file_time_type lastUse;
+        std::uintmax_t size;
+    };
+
+    std::error_code error;
+    std::vector<Stored> entries;
+    std::uintmax_t total = 0;
+    for (const auto &file: std::filesystem::directory_iterator(directory, error)) {
+        if (file.path().extension() != REPORT_EXTENSION) continue;
+
+        Stored entry{file.path(), file.path(), file.last_write_time(error), file.file_size(error)};
+        if (error) continue;
+        entry.image.replace_extension(IMAGE_EXTENSION);
+        const auto imageSize = std::filesystem::file_size(entry.image, error);
+        if (!error) entry.size += imageSize;
+        total += entry.size;
+        entries.push_back(std::move(entry));
+    }
+    if (total <= capacity) return;
+
+    std::ranges::sort(entries, {}, &Stored::lastUse);
+    for (const auto &entry: entries) {
+        if (total <= capacity) break;
+        // The report goes first, so readers never see an entry without its image
+        std::filesystem::remove(entry.report, error);
+        std::filesystem::remove(entry.image, error);
+        total -= entry.size;
+    }
+}
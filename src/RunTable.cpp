@@ -0,0 +1,230 @@
+#include "../include/RunTable.h"
+#include "../include/Profiler.h"
+#include <algorithm>
+#include <bit>
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#include <immintrin.h>
+#define PIXELFIXER_RUNS_AVX2 1
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#define PIXELFIXER_RUNS_NEON 1
+#endif
+
+namespace {
+    // ORs a 32-bit group of flags into a bitmask starting at an arbitrary bit
+    void orBits(uint64_t *out, int bit, uint32_t bits) {
+        const int shift = bit % 64;
+        out[bit / 64] |= static_cast<uint64_t>(bits) << shift;
+        if (shift > 32)
+            out[bit / 64 + 1] |= static_cast<uint64_t>(bits) >> (64 - shift);
+    }
+
+    // Sets bit (i + offset) of out for every i in [from, count) with a[i] != b[i]
+    template<typename T>
+    void differencesScalar(const T *a, const T *b, int from, int count, uint64_t *out, int offset) {
+        for (int i = from; i < count; ++i) {
+            if (a[i] != b[i]) {
+                const int bit = i + offset;
+                out[bit / 64] |= uint64_t{1} << (bit % 64);
+            }
+        }
+    }
+
+#if defined(PIXELFIXER_RUNS_AVX2)
+    bool hasAvx2() {
+        static const bool supported = __builtin_cpu_supports("avx2");
+        return supported;
+    }
+
+    // Both kernels consume 32 elements per step and return how many elements they covered
+    __attribute__((target("avx2")))
+    int differencesAvx2(const uint8_t *a, const uint8_t *b, int count, uint64_t *out, int offset) {
+        int i = 0;
+        for (; i + 32 <= count; i += 32) {
+            const __m256i va = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(a + i));
+            const __m256i vb = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(b + i));
+            const auto equal = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(va, vb)));
+            orBits(out, i + offset, ~equal);
+        }
+        return i;
+    }
+
+    __attribute__((target("avx2")))
+    int differencesAvx2(const uint16_t *a, const uint16_t *b, int count, uint64_t *out, int offset) {
+        int i = 0;
+        for (; i + 32 <= count; i += 32) {
+            const auto *pa = reinterpret_cast<const __m256i *>(a + i);
+            const auto *pb = reinterpret_cast<const __m256i *>(b + i);
+            const __m256i low = _mm256_cmpeq_epi16(_mm256_loadu_si256(pa), _mm256_loadu_si256(pb));
+            const __m256i high = _mm256_cmpeq_epi16(_mm256_loadu_si256(pa + 1), _mm256_loadu_si256(pb + 1));
+            // packs interleaves 128-bit lanes; the permute restores element order
+            const __m256i packed = _mm256_permute4x64_epi64(_mm256_packs_epi16(low, high), 0xD8);
+            const auto equal = static_cast<uint32_t>(_mm256_movemask_epi8(packed));
+            orBits(out, i + offset, ~equal);
+        }
+        return i;
+    }
+
+    __attribute__((target("avx2")))
+    int differencesAvx2(const uint32_t *a, const uint32_t *b, int count, uint64_t *out, int offset) {
+        int i = 0;
+        for (; i + 32 <= count; i += 32) {
+            uint32_t equal = 0;
+            for (int part = 0; part < 4; ++part) {
+                const auto *pa = reinterpret_cast<const __m256i *>(a + i + part * 8);
+                const auto *pb = reinterpret_cast<const __m256i *>(b + i + part * 8);
+                const __m256i same = _mm256_cmpeq_epi32(_mm256_loadu_si256(pa), _mm256_loadu_si256(pb));
+                equal |= static_cast<uint32_t>(_mm256_movemask_ps(_mm256_castsi256_ps(same))) << (part * 8);
+            }
+            orBits(out, i + offset, ~equal);
+        }
+        return i;
+    }
+#elif defined(PIXELFIXER_RUNS_NEON)
+    uint32_t movemask(uint8x16_t bytes) {
+        const uint8x16_t weights = {1, 2, 4, 8, 16, 32, 64, 128, 1, 2, 4, 8, 16, 32, 64, 128};
+        const uint8x16_t weighted = vandq_u8(bytes, weights);
+        return vaddv_u8(vget_low_u8(weighted)) | (static_cast<uint32_t>(vaddv_u8(vget_high_u8(weighted))) << 8);
+    }
+
+    // Both kernels consume 32 elements per step and return how many elements they covered
+    int differencesNeon(const uint8_t *a, const uint8_t *b, int count, uint64_t *out, int offset) {
+        int i = 0;
+        for (; i + 32 <= count; i += 32) {
+            const uint32_t low = movemask(vceqq_u8(vld1q_u8(a + i), vld1q_u8(b + i)));
+            const uint32_t high = movemask(vceqq_u8(vld1q_u8(a + i + 16), vld1q_u8(b + i + 16)));
+            orBits(out, i + offset, ~(low | (high << 16)));
+        }
+        return i;
+    }
+
+    int differencesNeon(const uint16_t *a, const uint16_t *b, int count, uint64_t *out, int offset) {
+        int i = 0;
+        for (; i + 32 <= count; i += 32) {
+            uint32_t equal = 0;
+            for (int half = 0; half < 2; ++half) {
+                const int j = i + half * 16;
+                const uint16x8_t low = vceqq_u16(vld1q_u16(a + j), vld1q_u16(b + j));
+                const uint16x8_t high = vceqq_u16(vld1q_u16(a + j + 8), vld1q_u16(b + j + 8));
+                equal |= movemask(vcombine_u8(vmovn_u16(low), vmovn_u16(high))) << (half * 16);
+            }
+            orBits(out, i + offset, ~equal);
+        }
+        return i;
+    }
+
+    int differencesNeon(const uint32_t *a, const uint32_t *b, int count, uint64_t *out, int offset) {
+        int i = 0;
+        for (; i + 32 <= count; i += 32) {
+            uint32_t equal = 0;
+            for (int half = 0; half < 2; ++half) {
+                const int j = i + half * 16;
+                const uint16x8_t low = vcombine_u16(vmovn_u32(vceqq_u32(vld1q_u32(a + j), vld1q_u32(b + j))),
+                                                    vmovn_u32(vceqq_u32(vld1q_u32(a + j + 4), vld1q_u32(b + j + 4))));
+                const uint16x8_t high = vcombine_u16(vmovn_u32(vceqq_u32(vld1q_u32(a + j + 8), vld1q_u32(b + j + 8))),
+                                                     vmovn_u32(vceqq_u32(vld1q_u32(a + j + 12), vld1q_u32(b + j + 12))));
+                equal |= movemask(vcombine_u8(vmovn_u16(low), vmovn_u16(high))) << (half * 16);
+            }
+            orBits(out, i + offset, ~equal);
+        }
+        return i;
+    }
+#endif
+
+    template<typename T>
+    void differences(const T *a, const T *b, int count, uint64_t *out, int offset) {
+        int done = 0;
+#if defined(PIXELFIXER_RUNS_AVX2)
+        if (hasAvx2()) done = differencesAvx2(a, b, count, out, offset);
+#elif defined(PIXELFIXER_RUNS_NEON)
+        done = differencesNeon(a, b, count, out, offset);
+#endif
+        differencesScalar(a, b, done, count, out, offset);
+    }
+
+    template<typename T>
+    void runStartsImpl(std::span<const T> row, uint64_t *starts) {
+        const int width = static_cast<int>(row.size());
+        std::fill_n(starts, (width + 63) / 64, 0);
+        if (width == 0) return;
+
+        // The first element always starts a run; every other one compares with its left neighbour
+        starts[0] = 1;
+        differences(row.data() + 1, row.data(), width - 1, starts, 1);
+    }
+
+    template<typename T>
+    void rowDifferencesImpl(std::span<const T> a, std::span<const T> b, uint64_t *out) {
+        const int width = static_cast<int>(a.size());
+        std::fill_n(out, (width + 63) / 64, 0);
+        differences(a.data(), b.data(), width, out, 0);
+    }
+}
+
+void RunTable::runStarts(std::span<const uint8_t> row, uint64_t *starts) {
+    runStartsImpl(row, starts);
+}
+
+void RunTable::runStarts(std::span<const uint16_t> row, uint64_t *starts) {
+    runStartsImpl(row, starts);
+}
+
+void RunTable::runStarts(std::span<const uint32_t> row, uint64_t *starts) {
+    runStartsImpl(row, starts);
+}
+
+void RunTable::rowDifferences(std::span<const uint8_t> a, std::span<const uint8_t> b, uint64_t *out) {
+    rowDifferencesImpl(a, b, out);
+}
+
+void RunTable::rowDifferences(std::span<const uint16_t> a, std::span<const uint16_t> b, uint64_t *out) {
+    rowDifferencesImpl(a, b, out);
+}
+
+void RunTable::rowDifferences(std::span<const uint32_t> a, std::span<const uint32_t> b, uint64_t *out) {
+    rowDifferencesImpl(a, b, out);
+}
+
+template<typename T>
+RunTable RunTable::build(std::span<const T> plane, int width, int height) {
+    PF_PROFILE_SCOPE("RunTable::build");
+    RunTable table;
+    table.width = width;
+    table.height = height;
+    table.rowOffsets.reserve(height + 1);
+
+    const int words = (width + 63) / 64;
+    std::vector<uint64_t> starts(words);
+
+    for (int y = 0; y < height; ++y) {
+        const std::span<const T> row = plane.subspan(static_cast<size_t>(y) * width, width);
+        runStarts(row, starts.data());
+
+        // Every set bit opens a run that closes right before the next one
+        int previous = -1;
+        for (int w = 0; w < words; ++w) {
+            uint64_t bits = starts[w];
+            while (bits != 0) {
+                const int x = w * 64 + std::countr_zero(bits);
+                bits &= bits - 1;
+                if (previous >= 0)
+                    table.runs.push_back({previous, x - 1, static_cast<uint16_t>(row[previous])});
+                previous = x;
+            }
+        }
+        if (previous >= 0)
+            table.runs.push_back({previous, width - 1, static_cast<uint16_t>(row[previous])});
+
+        table.rowOffsets.push_back(static_cast<int>(table.runs.size()));
+    }
+
+    return table;
+}
+
+template RunTable RunTable::build<uint8_t>(std::span<const uint8_t>, int, int);
+template RunTable RunTable::build<uint16_t>(std::span<const uint16_t>, int, int);
+
+RunTable RunTable::build(const PaletteIndex &index, int width, int height) {
+    return index.visitPlane([&](auto plane) { return build(plane, width, height); });
+}
@@ -0,0 +1,65 @@
+#include "../include/ScanlineReader.h"
+#include <iostream>
+#include <limits>
+
+namespace {
+    // Reads one header number, skipping whitespace and '#' comments before it
+    bool readHeaderValue(std::istream &in, int &value) {
+        while (true) {
+            in >> std::ws;
+            if (in.peek() != '#') break;
+            in.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+        }
+        return static_cast<bool>(in >> value);
+    }
+}
+
+ScanlineReader::ScanlineReader(const std::string &path) : file(path, std::ios::binary) {
+    if (!file) {
+        std::cerr << "Failed to open image: " << path << std::endl;
+        return;
+    }
+
+    char magic[2] = {};
+    file.read(magic, 2);
+    if (!file || magic[0] != 'P' || (magic[1] != '5' && magic[1] != '6')) {
+        std::cerr << "Not a binary PGM or PPM file: " << path << std::endl;
+        return;
+    }
+    format = magic[1] == '5' ? PixelFormat::Gray8 : PixelFormat::RGB8;
+
+    int maxValue = 0;
+    if (!readHeaderValue(file, width) || !readHeaderValue(file, height) || !readHeaderValue(file, maxValue) ||
+        width <= 0 || height <= 0) {
+        std::cerr << "Invalid PGM/PPM header: " << path << std::endl;
+        return;
+    }
+    if (maxValue <= 0 || maxValue > 255) {
+        std::cerr << "Only 8-bit PGM/PPM files are supported: " << path << std::endl;
+        return;
+    }
+
+    // Exactly one whitespace character separates the header from the pixels
+    file.get();
+    row.resize(static_cast<size_t>(width) * ImageView::bytesPerPixel(format));
+    valid = static_cast<bool>(file);
+}
+
+bool ScanlineReader::isSupported(const std::string &path) {
+    std::ifstream in(path, std::ios::binary);
+    char magic[2] = {};
+    in.read(magic, 2);
+    return in && magic[0] == 'P' && (magic[1] == '5' || magic[1] == '6');
+}
+
+const uint8_t *ScanlineReader::readRow() {
+    if (!valid || rowsRead >= height) return nullptr;
+    file.read(reinterpret_cast<char *>(row.data()), static_cast<std::streamsize>(row.size()));
+    if (!file) {
+        std::cerr << "Unexpected end of image data at row " << rowsRead << std::endl;
+        valid = false;
+        return nullptr;
+    }
+    ++rowsRead;
+    return row.data();
+}
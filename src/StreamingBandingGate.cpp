@@ -0,0 +1,69 @@
+#include "../include/StreamingBandingGate.h"
+#include "../include/MemoryStats.h"
+#include "../include/Profiler.h"
+#include "../include/ScanlineReader.h"
+#include "../include/ViewDetection.h"
+#include <iostream>
+#include <span>
+#include "stb_image.h"
+
+StreamingBandingGate::StreamingBandingGate(int width, PixelFormat format, int subjectThreshold)
+    : width(width), format(format), subjectThreshold(subjectThreshold), detector(width, false),
+      keys(width), subjectBits((width + 63) / 64) {
+}
+
+void StreamingBandingGate::pushRow(const uint8_t *row) {
+    packRow(row, width, format, subjectThreshold, keys.data(), subjectBits.data());
+    detector.pushRow(std::span<const uint32_t>(keys), subjectBits.data());
+    ++rows;
+}
+
+int StreamingBandingGate::finish() {
+    return detector.close().error;
+}
+
+size_t StreamingBandingGate::memoryBytes() const {
+    return detector.memoryBytes() + MemoryStats::vectorBytes(keys) + MemoryStats::vectorBytes(subjectBits);
+}
+
+int StreamingBandingGate::evaluateFile(const std::string &path, int subjectThreshold) {
+    PF_PROFILE_SCOPE("StreamingBandingGate::evaluateFile");
+    if (ScanlineReader::isSupported(path)) {
+        ScanlineReader reader(path);
+        if (!reader.isValid()) return -1;
+
+        StreamingBandingGate gate(reader.getWidth(), reader.getFormat(), subjectThreshold);
+        while (const uint8_t *row = reader.readRow()) gate.pushRow(row);
+        if (!reader.isValid()) return -1;
+
+        MemoryStats::recordStage("streamingGate", gate.memoryBytes());
+        return gate.finish();
+    }
+
+    int w, h, channels;
+    unsigned char *data = stbi_load(path.c_str(), &w, &h, &channels, 0);
+    if (data == nullptr) {
+        std::cerr << "Failed to load image: " << path << std::endl;
+        return -1;
+    }
+
+    // Pixels are converted as when loading the image, one row at a time
+    StreamingBandingGate gate(w, PixelFormat::RGB8, subjectThreshold);
+    std::vector<uint8_t> row(static_cast<size_t>(w) * 3);
+    for (int y = 0; y < h; ++y) {
+        const unsigned char *decoded = data + static_cast<size_t>(y) * w * channels;
+        for (int x = 0; x < w; ++x) {
+            const Color color = PixelArtImage::decodedColor(decoded + x * channels, channels);
+            row[3 * x] = color.r;
+            row[3 * x + 1] = color.g;
+            row[3 * x + 2] = color.b;
+        }
+        gate.pushRow(row.data());
+    }
+    stbi_image_free(data);
+
+    // The decoded image was held for the whole pass, so it counts towards the stage
+    MemoryStats::recordStage("streamingGate", gate.memoryBytes() + static_cast<size_t>(w) * h * channels +
+                                              MemoryStats::vectorBytes(row));
+    return gate.finish();
+}
@@ -0,0 +1,140 @@
+#include "../include/SubjectMask.h"
+#include "../include/Profiler.h"
+#include <algorithm>
+#include <bit>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define PIXELFIXER_SUBJECT_SSE2 1
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#define PIXELFIXER_SUBJECT_NEON 1
+#endif
+
+namespace {
+    bool isSubjectPixel(const uint8_t *pixel, int threshold) {
+        return pixel[0] < threshold || pixel[1] < threshold || pixel[2] < threshold;
+    }
+}
+
+int SubjectMask::classifyRow(const uint8_t *row, int width, int channels, int threshold,
+                             uint8_t *maskRow, uint64_t *bitRow) {
+    if (bitRow) std::fill_n(bitRow, (width + 63) / 64, 0);
+    threshold = std::clamp(threshold, 0, 256);
+
+    int count = 0;
+    int x = 0;
+
+    // Each vector step classifies 16 pixels; x stays a multiple of 16, so their bits never straddle a word
+    auto emit = [&](uint32_t laneBits) {
+        count += std::popcount(laneBits);
+        if (bitRow) bitRow[x / 64] |= static_cast<uint64_t>(laneBits) << (x % 64);
+    };
+
+#if defined(PIXELFIXER_SUBJECT_SSE2)
+    if (channels == 4 && threshold > 0) {
+        // byte < threshold  <=>  min(byte, threshold - 1) == byte
+        const __m128i limit = _mm_set1_epi8(static_cast<char>(threshold - 1));
+        const __m128i colorBytes = _mm_set1_epi32(0x00FFFFFF);
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i ones = _mm_set1_epi32(-1);
+
+        // All-ones 32-bit lane for every pixel with a color channel below the threshold
+        auto classify4 = [&](const uint8_t *pixels) {
+            const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(pixels));
+            const __m128i below = _mm_and_si128(_mm_cmpeq_epi8(_mm_min_epu8(v, limit), v), colorBytes);
+            return _mm_andnot_si128(_mm_cmpeq_epi32(below, zero), ones);
+        };
+
+        for (; x + 16 <= width; x += 16) {
+            const uint8_t *pixels = row + static_cast<size_t>(x) * 4;
+            const __m128i bytes = _mm_packs_epi16(
+                _mm_packs_epi32(classify4(pixels), classify4(pixels + 16)),
+                _mm_packs_epi32(classify4(pixels + 32), classify4(pixels + 48)));
+
+            if (maskRow) _mm_storeu_si128(reinterpret_cast<__m128i *>(maskRow + x), bytes);
+            emit(static_cast<uint32_t>(_mm_movemask_epi8(bytes)));
+        }
+    }
+#elif defined(PIXELFIXER_SUBJECT_NEON)
+    if ((channels == 3 || channels == 4) && threshold > 0) {
+        const uint8x16_t limit = vdupq_n_u8(static_cast<uint8_t>(threshold - 1));
+        const uint8x16_t weights = {1, 2, 4, 8, 16, 32, 64, 128, 1, 2, 4, 8, 16, 32, 64, 128};
+
+        for (; x + 16 <= width; x += 16) {
+            uint8x16_t minimum;
+            if (channels == 4) {
+                const uint8x16x4_t px = vld4q_u8(row + static_cast<size_t>(x) * 4);
+                minimum = vminq_u8(vminq_u8(px.val[0], px.val[1]), px.val[2]);
+            } else {
+                const uint8x16x3_t px = vld3q_u8(row + static_cast<size_t>(x) * 3);
+                minimum = vminq_u8(vminq_u8(px.val[0], px.val[1]), px.val[2]);
+            }
+            const uint8x16_t bytes = vcleq_u8(minimum, limit);
+
+            if (maskRow) vst1q_u8(maskRow + x, bytes);
+
+            const uint8x16_t weighted = vandq_u8(bytes, weights);
+            const uint32_t low = vaddv_u8(vget_low_u8(weighted));
+            const uint32_t high = vaddv_u8(vget_high_u8(weighted));
+            emit(low | (high << 8));
+        }
+    }
+#endif
+
+    // Scalar tail (and the whole row for layouts the vector paths do not cover)
+    for (; x < width; ++x) {
+        const bool subject = isSubjectPixel(row + static_cast<size_t>(x) * channels, threshold);
+        if (maskRow) maskRow[x] = subject ? 255 : 0;
+        if (subject) {
+            ++count;
+            if (bitRow) bitRow[x / 64] |= uint64_t{1} << (x % 64);
+        }
+    }
+
+    return count;
+}
+
+SubjectMask SubjectMask::compute(const uint8_t *data, int width, int height, int channels, int threshold) {
+    const size_t rowBytes = static_cast<size_t>(width) * channels;
+    return compute(width, height, channels, threshold, [&](int y) { return data + y * rowBytes; });
+}
+
+SubjectMask SubjectMask::compute(int width, int height, int channels, int threshold,
+                                 const std::function<const uint8_t *(int y)> &row) {
+    PF_PROFILE_SCOPE("SubjectMask::compute");
+    SubjectMask result;
+    result.mask = cv::Mat(height, width, CV_8UC1, cv::Scalar(0));
+    result.wordsPerRow = (width + 63) / 64;
+    result.bits.assign(static_cast<size_t>(height) * result.wordsPerRow, 0);
+
+    int minX = width, maxX = -1, minY = height, maxY = -1;
+
+    for (int y = 0; y < height; ++y) {
+        uint64_t *bitRow = result.bits.data() + static_cast<size_t>(y) * result.wordsPerRow;
+        const int rowCount = classifyRow(row(y), width, channels, threshold,
+                                         result.mask.ptr<uint8_t>(y), bitRow);
+        if (rowCount == 0) continue;
+
+        result.count += rowCount;
+        minY = std::min(minY, y);
+        maxY = y;
+
+        // Leftmost and rightmost subject pixels straight from the bitmask
+        for (int w = 0; w < result.wordsPerRow; ++w) {
+            if (bitRow[w] == 0) continue;
+            minX = std::min(minX, w * 64 + std::countr_zero(bitRow[w]));
+            break;
+        }
+        for (int w = result.wordsPerRow - 1; w >= 0; --w) {
+            if (bitRow[w] == 0) continue;
+            maxX = std::max(maxX, w * 64 + 63 - std::countl_zero(bitRow[w]));
+            break;
+        }
+    }
+
+    if (maxY >= 0)
+        result.bounds = cv::Rect(minX, minY, maxX - minX + 1, maxY - minY + 1);
+
+    return result;
+}
@@ -0,0 +1,171 @@
+#include "../include/TaskScheduler.h"
+#include <optional>
+
+namespace {
+    // Identifies the worker running on the current thread, if any
+    thread_local const TaskScheduler *currentScheduler = nullptr;
+    thread_local int currentWorker = -1;
+
+    std::mutex globalMutex;
+    std::unique_ptr<TaskScheduler> globalScheduler;
+    int globalThreads = 0;
+
+    int workersFor(int threads) {
+        if (threads <= 0) threads = static_cast<int>(std::thread::hardware_concurrency());
+        return std::max(threads, 1) - 1;
+    }
+}
+
+TaskScheduler::TaskScheduler(int workerCount) {
+    workerCount = std::max(workerCount, 0);
+    for (int i = 0; i < workerCount; ++i)
+        queues.push_back(std::make_unique<Queue>());
+    for (int i = 0; i < workerCount; ++i)
+        workers.emplace_back([this, i] { workerLoop(i); });
+}
+
+TaskScheduler::~TaskScheduler() {
+    stopping = true;
+    notifyAll();
+    for (auto &worker: workers)
+        worker.join();
+}
+
+TaskScheduler &TaskScheduler::global() {
+    std::lock_guard lock(globalMutex);
+    if (!globalScheduler)
+        globalScheduler = std::make_unique<TaskScheduler>(workersFor(globalThreads));
+    return *globalScheduler;
+}
+
+void TaskScheduler::setGlobalThreadCount(int threads) {
+    std::lock_guard lock(globalMutex);
+    globalThreads = threads;
+    globalScheduler.reset();
+}
+
+bool TaskScheduler::isWorkerThread() const {
+    return currentScheduler == this;
+}
+
+void TaskScheduler::submit(Task task, int affinity) {
+    if (workers.empty()) {
+        execute(task);
+        return;
+    }
+
+    const int count = static_cast<int>(queues.size());
+    int target;
+    if (affinity >= 0)
+        target = affinity % count;
+    else if (isWorkerThread())
+        target = currentWorker;
+    else
+        target = static_cast<int>(nextQueue++ % static_cast<unsigned>(count));
+
+    {
+        std::lock_guard lock(queues[target]->mutex);
+        queues[target]->tasks.push_back(std::move(task));
+    }
+    ++queued;
+    notifyAll();
+}
+
+bool TaskScheduler::tryRunOne() {
+    if (queues.empty()) return false;
+
+    const int count = static_cast<int>(queues.size());
+    const int own = isWorkerThread() ? currentWorker : -1;
+    std::optional<Task> task;
+
+    // Newest task of our own deque first, then the oldest task of anyone else's
+    if (own >= 0) {
+        std::lock_guard lock(queues[own]->mutex);
+        if (!queues[own]->tasks.empty()) {
+            task = std::move(queues[own]->tasks.back());
+            queues[own]->tasks.pop_back();
+        }
+    }
+    for (int i = 1; !task && i <= count; ++i) {
+        const int victim = (own + i + count) % count;
+        std::lock_guard lock(queues[victim]->mutex);
+        if (!queues[victim]->tasks.empty()) {
+            task = std::move(queues[victim]->tasks.front());
+            queues[victim]->tasks.pop_front();
+        }
+    }
+
+    if (!task) return false;
+    --queued;
+    execute(*task);
+    return true;
+}
+
+void TaskScheduler::execute(Task &task) {
+    std::exception_ptr taskError;
+    try {
+        task.function();
+    } catch (...) {
+        taskError = std::current_exception();
+    }
+    task.group->finishTask(taskError);
+}
+
+void TaskScheduler::notifyAll() {
+    {
+        std::lock_guard lock(sleepMutex);
+    }
+    wake.notify_all();
+}
+
+void TaskScheduler::workerLoop(int index) {
+    currentScheduler = this;
+    currentWorker = index;
+
+    while (!stopping) {
+        if (tryRunOne()) continue;
+
+        std::unique_lock lock(sleepMutex);
+        wake.wait(lock, [this] { return stopping.load() || queued.load() > 0; });
+    }
+}
+
+TaskGroup::~TaskGroup() {
+    try {
+        wait();
+    } catch (...) {
+        // Errors of a group that was never joined have nobody to report to
+    }
+}
+
+void TaskGroup::run(std::function<void()> function, int affinity) {
+    ++pending;
+    scheduler.submit({std::move(function), this}, affinity);
+}
+
+void TaskGroup::wait() {
+    while (pending.load() > 0) {
+        if (scheduler.tryRunOne()) continue;
+
+        std::unique_lock lock(scheduler.sleepMutex);
+        scheduler.wake.wait(lock, [this] { return pending.load() == 0 || scheduler.queued.load() > 0; });
+    }
+
+    std::exception_ptr taskError;
+    {
+        std::lock_guard lock(errorMutex);
+        std::swap(taskError, error);
+    }
+    if (taskError) std::rethrow_exception(taskError);
+}
+
+void TaskGroup::finishTask(std::exception_ptr taskError) {
+    if (taskError) {
+        std::lock_guard lock(errorMutex);
+        if (!error) error = taskError;
+    }
+
+    // The group may be destroyed as soon as pending reaches zero
+    TaskScheduler &owner = scheduler;
+    if (--pending == 0) owner.notifyAll();
+}
@@ -0,0 +1,14 @@
+#include "../include/ThreadCpuClock.h"
+
+#if defined(__linux__) || defined(__APPLE__)
+#include <time.h>
+#endif
+
+ThreadCpuClock::time_point ThreadCpuClock::now() noexcept {
+#if defined(__linux__) || defined(__APPLE__)
+    timespec time{};
+    if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &time) == 0)
+        return time_point(std::chrono::seconds(time.tv_sec) + std::chrono::nanoseconds(time.tv_nsec));
+#endif
+    return time_point(std::chrono::duration_cast<duration>(std::chrono::steady_clock::now().time_since_epoch()));
+}
@@ -0,0 +1,94 @@
+#include "../include/ViewDetection.h"
+#include "../include/Profiler.h"
+#include "../include/SubjectMask.h"
+#include <algorithm>
+#include <span>
+
+namespace {
+    // Packs each pixel's color into one key; R and B are channel offsets
+    template<int Bytes, int R, int B>
+    void colorKeys(const uint8_t *row, int width, uint32_t *keys) {
+        for (int x = 0; x < width; ++x) {
+            const uint8_t *pixel = row + x * Bytes;
+            keys[x] = static_cast<uint32_t>(pixel[R]) << 16 | static_cast<uint32_t>(pixel[1]) << 8 | pixel[B];
+        }
+    }
+
+    void grayRow(const uint8_t *row, int width, int threshold, uint32_t *keys, uint64_t *subjectBits) {
+        std::fill_n(subjectBits, (width + 63) / 64, 0);
+        for (int x = 0; x < width; ++x) {
+            keys[x] = row[x];
+            if (row[x] < threshold)
+                subjectBits[x / 64] |= uint64_t{1} << (x % 64);
+        }
+    }
+
+}
+
+void packRow(const uint8_t *row, int width, PixelFormat format, int subjectThreshold, uint32_t *keys,
+             uint64_t *subjectBits) {
+    switch (format) {
+        case PixelFormat::Gray8: grayRow(row, width, subjectThreshold, keys, subjectBits); return;
+        case PixelFormat::RGB8: colorKeys<3, 0, 2>(row, width, keys); break;
+        case PixelFormat::BGR8: colorKeys<3, 2, 0>(row, width, keys); break;
+        case PixelFormat::RGBA8: colorKeys<4, 0, 2>(row, width, keys); break;
+        case PixelFormat::BGRA8: colorKeys<4, 2, 0>(row, width, keys); break;
+    }
+    // The subject test ignores channel order, so BGR rows go through the same kernel as RGB ones
+    SubjectMask::classifyRow(row, width, ImageView::bytesPerPixel(format), subjectThreshold, nullptr, subjectBits);
+}
+
+namespace {
+    void reportPairs(const BitboardBandingDetector::Result &result, std::vector<BitboardBandingDetector::Pair> *pairs) {
+        if (pairs) pairs->assign(result.pairs.begin(), result.pairs.end());
+    }
+}
+
+int detectBanding(const ImageView &image, DetectionScratch &scratch,
+                  std::vector<BitboardBandingDetector::Pair> *pairs, int subjectThreshold) {
+    PF_PROFILE_SCOPE("detectBanding(ImageView)");
+    if (!image.isValid()) return -1;
+
+    const int width = image.width;
+    scratch.detector.reset(width, pairs != nullptr);
+    scratch.keys.resize(width);
+    scratch.subjectBits.resize((width + 63) / 64);
+
+    for (int y = 0; y < image.height; ++y) {
+        packRow(image.row(y), width, image.format, subjectThreshold, scratch.keys.data(), scratch.subjectBits.data());
+        scratch.detector.pushRow(std::span<const uint32_t>(scratch.keys), scratch.subjectBits.data());
+    }
+
+    const auto &result = scratch.detector.close();
+    reportPairs(result, pairs);
+    return result.error;
+}
+
+int detectBanding(const PaletteIndex &index, int width, int height, DetectionScratch &scratch,
+                  std::vector<BitboardBandingDetector::Pair> *pairs, int subjectThreshold) {
+    PF_PROFILE_SCOPE("detectBanding(PaletteIndex)");
+    if (!index.isValid()) return -1;
+
+    // The subject test is done once per palette entry
+    scratch.subjectEntries.clear();
+    for (const Color &color: index.getPalette())
+        scratch.subjectEntries.push_back(PixelArtImage::isSubjectColor(color, subjectThreshold));
+
+    scratch.detector.reset(width, pairs != nullptr);
+    scratch.subjectBits.resize((width + 63) / 64);
+
+    index.visitPlane([&](auto plane) {
+        for (int y = 0; y < height; ++y) {
+            const auto row = plane.subspan(static_cast<size_t>(y) * width, width);
+            std::ranges::fill(scratch.subjectBits, 0);
+            for (int x = 0; x < width; ++x)
+                if (scratch.subjectEntries[row[x]])
+                    scratch.subjectBits[x / 64] |= uint64_t{1} << (x % 64);
+            scratch.detector.pushRow(row, scratch.subjectBits.data());
+        }
+    });
+
+    const auto &result = scratch.detector.close();
+    reportPairs(result, pairs);
+    return result.error;
+}
@@ -0,0 +1,482 @@
+// Headless front-end: runs one algorithm on one image, or on a batch of images, without opening a window.
+
+#include <cstdio>
+#include <filesystem>
+#include <iostream>
+#include <memory>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "../include/PixelArtImage.h"
+#include "../include/Algorithm.h"
+#include "../include/BandingDetection.h"
+#include "../include/FrameSequence.h"
+#include "../include/GeneralBandingCorrection.h"
+#include "../include/IncrementalBandingDetector.h"
+#include "../include/MemoryStats.h"
+#include "../include/PillowShadingCorrection.h"
+#include "../include/Profiler.h"
+#include "../include/ResultCache.h"
+#include "../include/ScanlineReader.h"
+#include "../include/StreamingBandingGate.h"
+#include "../include/TaskScheduler.h"
+
+namespace {
+    struct Options {
+        std::string algorithm = "detect";
+        std::vector<std::string> inputs;
+        std::string output;
+        std::string outputDirectory;
+        int threads = 0;
+        std::string cacheDirectory;
+        std::uintmax_t cacheMegabytes = 1024;
+        bool sequence = false;
+        int frameWidth = 0;
+        std::string tracePath;
+        bool stats = false;
+        BandingDetection::Engine engine = BandingDetection::Engine::Bitboard;
+        std::optional<Pos> generator;
+        std::optional<int> gateLimit;
+        PillowShadingCorrection::SearchMode search = PillowShadingCorrection::SearchMode::RandomRestarts;
+        std::optional<int> searchBudget;
+    };
+
+    void printUsage(const char *program) {
+        std::cout << "Usage: " << program << " [options] <input> [<output>]\n"
+                  << "       " << program << " [options] --output-dir <dir> <input>...\n"
+                  << "  --algorithm <name>   detect (default), banding or pillow\n"
+                  << "  --generator <x>,<y>  generator pixel for pillow-shading correction\n"
+                  << "  --search <mode>      pillow-shading search: restarts (default) or annealing\n"
+                  << "  --search-budget <ms> CPU time shared by all annealing chains (default 2000); each chain\n"
+                  << "                       counts its share on its own thread, so wall time depends on the cores\n"
+                  << "  --engine <name>      banding detection engine: bitboard (default) or reference\n"
+                  << "  --output-dir <dir>   batch mode: process every input, saving results under <dir>\n"
+                  << "  --threads <n>        worker threads shared by all images (default: all cores, 1 = serial)\n"
+                  << "  --sequence           treat the inputs as animation frames (or one strip) and only\n"
+                  << "                       re-detect and re-correct what changed between frames\n"
+                  << "  --frame-width <n>    frame width of a single-image strip (default: square frames)\n"
+                  << "  --gate <max-error>   pass every input through the banding-error gate; exit with 1 if any\n"
+                  << "                       error exceeds <max-error>. Binary PGM/PPM inputs are streamed row by\n"
+                  << "                       row in memory independent of their height; other formats are decoded\n"
+                  << "                       whole, one at a time\n"
+                  << "  --cache <dir>        reuse results of unchanged inputs and settings from <dir>\n"
+                  << "  --cache-size <MB>    cache size before least recently used entries are evicted (default 1024)\n"
+                  << "  --trace <file>       write profiler zones as Chrome trace_event JSON\n"
+                  << "  --stats              report the memory held per image and the peak memory per stage\n"
+                  << "  -h, --help           show this message\n";
+    }
+
+    std::optional<Options> parseArguments(int argc, char **argv) {
+        Options options;
+        std::vector<std::string> positional;
+
+        for (int i = 1; i < argc; ++i) {
+            std::string arg = argv[i];
+            auto nextValue = [&]() -> std::optional<std::string> {
+                if (i + 1 >= argc) {
+                    std::cerr << "Missing value for " << arg << std::endl;
+                    return std::nullopt;
+                }
+                return std::string(argv[++i]);
+            };
+
+            if (arg == "-h" || arg == "--help") {
+                return std::nullopt;
+            } else if (arg == "--algorithm") {
+                auto value = nextValue();
+                if (!value) return std::nullopt;
+                options.algorithm = *value;
+            } else if (arg == "--generator") {
+                auto value = nextValue();
+                if (!value) return std::nullopt;
+                int x = 0, y = 0;
+                if (std::sscanf(value->c_str(), "%d,%d", &x, &y) != 2) {
+                    std::cerr << "Invalid generator: " << *value << std::endl;
+                    return std::nullopt;
+                }
+                options.generator = Pos(x, y);
+            } else if (arg == "--search") {
+                auto value = nextValue();
+                if (!value) return std::nullopt;
+                if (*value == "restarts") {
+                    options.search = PillowShadingCorrection::SearchMode::RandomRestarts;
+                } else if (*value == "annealing") {
+                    options.search = PillowShadingCorrection::SearchMode::Annealing;
+                } else {
+                    std::cerr << "Unknown search mode: " << *value << std::endl;
+                    return std::nullopt;
+                }
+            } else if (arg == "--search-budget") {
+                auto value = nextValue();
+                if (!value) return std::nullopt;
+                int milliseconds = 0;
+                if (std::sscanf(value->c_str(), "%d", &milliseconds) != 1 || milliseconds <= 0) {
+                    std::cerr << "Invalid search budget: " << *value << std::endl;
+                    return std::nullopt;
+                }
+                options.searchBudget = milliseconds;
+            } else if (arg == "--engine") {
+                auto value = nextValue();
+                if (!value) return std::nullopt;
+                if (*value == "bitboard") {
+                    options.engine = BandingDetection::Engine::Bitboard;
+                } else if (*value == "reference") {
+                    options.engine = BandingDetection::Engine::Reference;
+                } else {
+                    std::cerr << "Unknown engine: " << *value << std::endl;
+                    return std::nullopt;
+                }
+            } else if (arg == "--output-dir") {
+                auto value = nextValue();
+                if (!value) return std::nullopt;
+                options.outputDirectory = *value;
+            } else if (arg == "--threads") {
+                auto value = nextValue();
+                if (!value) return std::nullopt;
+                if (std::sscanf(value->c_str(), "%d", &options.threads) != 1 || options.threads < 0) {
+                    std::cerr << "Invalid thread count: " << *value << std::endl;
+                    return std::nullopt;
+                }
+            } else if (arg == "--sequence") {
+                options.sequence = true;
+            } else if (arg == "--frame-width") {
+                auto value = nextValue();
+                if (!value) return std::nullopt;
+                if (std::sscanf(value->c_str(), "%d", &options.frameWidth) != 1 || options.frameWidth < 0) {
+                    std::cerr << "Invalid frame width: " << *value << std::endl;
+                    return std::nullopt;
+                }
+            } else if (arg == "--gate") {
+                auto value = nextValue();
+                if (!value) return std::nullopt;
+                int limit = 0;
+                if (std::sscanf(value->c_str(), "%d", &limit) != 1 || limit < 0) {
+                    std::cerr << "Invalid gate error limit: " << *value << std::endl;
+                    return std::nullopt;
+                }
+                options.gateLimit = limit;
+            } else if (arg == "--cache") {
+                auto value = nextValue();
+                if (!value) return std::nullopt;
+                options.cacheDirectory = *value;
+            } else if (arg == "--cache-size") {
+                auto value = nextValue();
+                if (!value) return std::nullopt;
+                unsigned long long megabytes = 0;
+                if (std::sscanf(value->c_str(), "%llu", &megabytes) != 1) {
+                    std::cerr << "Invalid cache size: " << *value << std::endl;
+                    return std::nullopt;
+                }
+                options.cacheMegabytes = megabytes;
+            } else if (arg == "--trace") {
+                auto value = nextValue();
+                if (!value) return std::nullopt;
+                options.tracePath = *value;
+            } else if (arg == "--stats") {
+                options.stats = true;
+            } else if (arg.starts_with("-")) {
+                std::cerr << "Unknown option: " << arg << std::endl;
+                return std::nullopt;
+            } else {
+                positional.push_back(arg);
+            }
+        }
+
+        if (positional.empty()) return std::nullopt;
+        if (!options.outputDirectory.empty() || options.sequence || options.gateLimit) {
+            options.inputs = positional;
+            return options;
+        }
+
+        if (positional.size() > 2) return std::nullopt;
+        options.inputs = {positional[0]};
+        if (positional.size() == 2) options.output = positional[1];
+        return options;
+    }
+
+    std::unique_ptr<Algorithm> createAlgorithm(const std::string &name, PixelArtImage &image) {
+        if (name == "detect") return std::make_unique<BandingDetection>(image);
+        if (name == "banding") return std::make_unique<GeneralBandingCorrection>(image);
+        if (name == "pillow") return std::make_unique<PillowShadingCorrection>(image);
+        return nullptr;
+    }
+
+    /**
+     * Applies the algorithm-specific options.
+     * @param options the parsed command line
+     * @param algorithm an algorithm made by createAlgorithm
+     */
+    void configureAlgorithm(const Options &options, Algorithm &algorithm) {
+        if (auto *detection = dynamic_cast<BandingDetection *>(&algorithm))
+            detection->setEngine(options.engine);
+        if (auto *pillow = dynamic_cast<PillowShadingCorrection *>(&algorithm)) {
+            pillow->setSearchMode(options.search);
+            if (options.searchBudget) pillow->setSearchBudget(*options.searchBudget);
+        }
+    }
+
+    /**
+     * Describes the memory held by an image and by an algorithm's scratch after a run.
+     * @return one indented line per structure
+     */
+    std::string describeMemory(const PixelArtImage &image, const Algorithm &algorithm) {
+        std::ostringstream lines;
+        auto describe = [&](const char *title, const MemoryBreakdown &breakdown) {
+            lines << "\n  " << title << ": " << MemoryStats::formatBytes(MemoryStats::total(breakdown));
+            for (const auto &item: breakdown)
+                if (item.bytes > 0) lines << "\n    " << item.name << ": " << MemoryStats::formatBytes(item.bytes);
+        };
+        describe("image", image.getMemoryUsage());
+        describe("algorithm scratch", algorithm.getMemoryUsage());
+        return lines.str();
+    }
+
+    /**
+     * Prints the high-water mark of every recorded stage and the process's peak resident set size.
+     */
+    void printStageStats() {
+        std::cout << "Memory peaks per stage:" << std::endl;
+        for (const auto &stage: MemoryStats::getStageStats())
+            std::cout << "  " << stage.name << ": " << MemoryStats::formatBytes(stage.peakBytes) << " (" << stage.samples
+                    << " samples)" << std::endl;
+        std::cout << "Peak resident set: " << MemoryStats::formatBytes(MemoryStats::peakResidentBytes()) << std::endl;
+    }
+
+    /**
+     * Loads one image, runs the selected algorithm on it, scores the result and saves it.
+     * @param options the parsed command line
+     * @param input the image to process
+     * @param output where to save the result, or empty to skip saving
+     * @param report receives the result line
+     * @param cache serves and stores results, or nullptr
+     * @return the process exit code for this image
+     */
+    int processImage(const Options &options, const std::string &input, const std::string &output, std::string &report,
+                     const ResultCache *cache) {
+        PixelArtImage image(0, 0);
+        if (!image.loadFromFile(input)) return 1;
+        if (options.generator)
+            image.setGenerator(Pixel{{255, 0, 0}, *options.generator});
+
+        auto algorithm = createAlgorithm(options.algorithm, image);
+        configureAlgorithm(options, *algorithm);
+
+        std::string key;
+        if (cache) {
+            key = ResultCache::key(image, *algorithm);
+            if (auto entry = cache->find(key)) {
+                std::error_code error;
+                if (output.empty() || std::filesystem::copy_file(entry->image, output,
+                                                                 std::filesystem::copy_options::overwrite_existing,
+                                                                 error)) {
+                    report = algorithm->name() + ": banding error " + std::to_string(entry->bandingError) + " (cached)";
+                    return 0;
+                }
+                // Evicted by another worker in the meantime; compute it again
+            }
+        }
+
+        algorithm->reset();
+        algorithm->run();
+
+        const int bandingError = BandingDetection::detect(image, options.engine).error;
+        std::ostringstream line;
+        line << algorithm->name() << ": banding error " << bandingError;
+        if (options.stats) line << describeMemory(image, *algorithm);
+        report = line.str();
+
+        if (cache && !cache->store(key, image, bandingError))
+            std::cerr << "Failed to cache the result of " << input << std::endl;
+
+        if (!output.empty() && !image.saveToFile(output)) {
+            std::cerr << "Failed to save image: " << output << std::endl;
+            return 1;
+        }
+        return 0;
+    }
+
+    /**
+     * Gates every input on its banding error. PGM/PPM inputs are streamed row by row and gated
+     * concurrently; each gate holds a few rows' worth of memory, whatever the image height. Other
+     * formats must be decoded whole, so they are gated one after another beside the streamed ones,
+     * and at most one decoded image is held at a time.
+     * @param options the parsed command line
+     * @return 0 if every input is within the limit, 1 otherwise
+     */
+    int runGate(const Options &options) {
+        const auto &inputs = options.inputs;
+        std::vector<int> errors(inputs.size(), 0);
+        std::vector<size_t> decodedInputs;
+        TaskGroup group;
+        for (size_t i = 0; i < inputs.size(); ++i) {
+            if (ScanlineReader::isSupported(inputs[i]))
+                group.run([&, i] { errors[i] = StreamingBandingGate::evaluateFile(inputs[i]); });
+            else
+                decodedInputs.push_back(i);
+        }
+        group.run([&] {
+            for (size_t i: decodedInputs) errors[i] = StreamingBandingGate::evaluateFile(inputs[i]);
+        });
+        group.wait();
+
+        int status = 0;
+        for (size_t i = 0; i < inputs.size(); ++i) {
+            if (errors[i] < 0) {
+                status = 1;
+                continue;
+            }
+            const bool passed = errors[i] <= *options.gateLimit;
+            if (!passed) status = 1;
+            std::cout << inputs[i] << ": banding error " << errors[i] << (passed ? " (pass)" : " (fail)") << std::endl;
+        }
+        return status;
+    }
+
+    /**
+     * Processes the frames of an animation in order. Frames identical to the previous one reuse its
+     * result; banding correction starts from the previous frame's corrected pixels away from the
+     * changes, and banding is only re-detected on rows and columns that changed.
+     * @param options the parsed command line
+     * @return the process exit code
+     */
+    int processSequence(const Options &options) {
+        const FrameSequence sequence = options.inputs.size() == 1
+                                           ? FrameSequence::fromStrip(options.inputs.front(), options.frameWidth)
+                                           : FrameSequence::fromFiles(options.inputs);
+        if (sequence.getFrameCount() == 0) return 1;
+
+        PixelArtImage previousInput(0, 0);
+        PixelArtImage previousResult(0, 0);
+        IncrementalBandingDetector detector;
+
+        for (int i = 0; i < sequence.getFrameCount(); ++i) {
+            PixelArtImage frame(0, 0);
+            if (!sequence.loadFrame(i, frame)) return 1;
+
+            const bool first = i == 0;
+            const FrameSequence::FrameDiff inputDiff = FrameSequence::diff(previousInput, frame);
+
+            PixelArtImage result = frame;
+            auto algorithm = createAlgorithm(options.algorithm, result);
+            configureAlgorithm(options, *algorithm);
+            if (options.algorithm != "detect") {
+                if (!first && inputDiff.empty()) {
+                    result = previousResult;
+                } else {
+                    if (options.generator)
+                        result.setGenerator(Pixel{{255, 0, 0}, *options.generator});
+                    algorithm->reset();
+                    // Pillow-shading rebuilds its layers from the whole sprite, so only banding correction warm-starts
+                    if (!first && options.algorithm == "banding")
+                        FrameSequence::carryOver(previousResult, inputDiff, 1, result);
+                    algorithm->run();
+                }
+            }
+
+            const FrameSequence::FrameDiff resultDiff = FrameSequence::diff(previousResult, result);
+            const auto detection = detector.update(result, first ? nullptr : &resultDiff);
+
+            std::cout << sequence.frameName(i) << ": " << algorithm->name() << ": banding error " << detection.error
+                    << " (" << inputDiff.changedPixels << " pixels changed, " << detector.getScannedLines()
+                    << " lines scanned)" << std::endl;
+
+            if (!options.outputDirectory.empty()) {
+                const auto output = std::filesystem::path(options.outputDirectory) / sequence.frameName(i);
+                if (!result.saveToFile(output.string())) {
+                    std::cerr << "Failed to save image: " << output.string() << std::endl;
+                    return 1;
+                }
+            }
+
+            previousInput = frame;
+            previousResult = result;
+        }
+        return 0;
+    }
+}
+
+int main(int argc, char **argv) {
+    auto options = parseArguments(argc, argv);
+    if (!options) {
+        printUsage(argv[0]);
+        return 2;
+    }
+
+    PixelArtImage probe(0, 0);
+    if (!createAlgorithm(options->algorithm, probe)) {
+        std::cerr << "Unknown algorithm: " << options->algorithm << std::endl;
+        return 2;
+    }
+
+    TaskScheduler::setGlobalThreadCount(options->threads);
+
+    std::optional<ResultCache> cache;
+    if (!options->cacheDirectory.empty()) {
+        cache.emplace(options->cacheDirectory, options->cacheMegabytes * 1024 * 1024);
+        if (!cache->isValid()) {
+            std::cerr << "Failed to open cache directory: " << options->cacheDirectory << std::endl;
+            return 1;
+        }
+    }
+    const ResultCache *resultCache = cache ? &*cache : nullptr;
+
+    int status = 0;
+    if (options->gateLimit) {
+        status = runGate(*options);
+    } else if (options->sequence) {
+        if (!options->outputDirectory.empty()) {
+            std::error_code error;
+            std::filesystem::create_directories(options->outputDirectory, error);
+        }
+        status = processSequence(*options);
+    } else if (options->outputDirectory.empty()) {
+        std::string report;
+        status = processImage(*options, options->inputs.front(), options->output, report, resultCache);
+        if (status != 0) return status;
+        std::cout << report << std::endl;
+    } else {
+        std::error_code error;
+        std::filesystem::create_directories(options->outputDirectory, error);
+        if (error) {
+            std::cerr << "Failed to create output directory: " << options->outputDirectory << std::endl;
+            return 1;
+        }
+
+        // Every image is a task; the algorithms fork their own work onto the same workers
+        const auto &inputs = options->inputs;
+        std::vector<std::string> reports(inputs.size());
+        std::vector<int> statuses(inputs.size(), 0);
+        TaskGroup group;
+        for (size_t i = 0; i < inputs.size(); ++i) {
+            group.run([&, i] {
+                const auto output = std::filesystem::path(options->outputDirectory) /
+                                    std::filesystem::path(inputs[i]).filename();
+                statuses[i] = processImage(*options, inputs[i], output.string(), reports[i], resultCache);
+            });
+        }
+        group.wait();
+
+        for (size_t i = 0; i < inputs.size(); ++i) {
+            if (statuses[i] != 0) {
+                status = statuses[i];
+                continue;
+            }
+            std::cout << inputs[i] << ": " << reports[i] << std::endl;
+        }
+    }
+
+    if (options->stats) printStageStats();
+
+    if (!options->tracePath.empty()) {
+        if (!Profiler::isEnabled())
+            std::cerr << "Profiling zones were compiled out; the trace will be empty." << std::endl;
+        if (!Profiler::exportChromeTrace(options->tracePath)) {
+            std::cerr << "Failed to write trace: " << options->tracePath << std::endl;
+            return 1;
+        }
+    }
+
+    return status;
+}
@@ -0,0 +1,484 @@
+// Golden-output harness: runs every algorithm over a corpus, compares the results and banding errors
+// with stored golden files and records throughput in the same run.
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <ctime>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <iterator>
+#include <limits>
+#include <map>
+#include <memory>
+#include <optional>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "../include/PixelArtImage.h"
+#include "../include/Algorithm.h"
+#include "../include/BandingDetection.h"
+#include "../include/GeneralBandingCorrection.h"
+#include "../include/PillowShadingCorrection.h"
+#include "../include/TaskScheduler.h"
+
+namespace {
+    const std::vector<std::string> ALGORITHMS = {"detect", "banding", "pillow"};
+    constexpr int MAX_REPORTED_PIXELS = 8;
+
+    struct Options {
+        std::string goldenDirectory = "assets/golden";
+        std::string corpusDirectory = "assets/images";
+        std::vector<std::string> algorithms = ALGORITHMS;
+        std::string csvPath;
+        bool update = false;
+        bool generated = true;
+        int threads = 0;
+        int searchRuns = 0;
+        int searchBudgetMs = 50;
+    };
+
+    struct CorpusImage {
+        std::string name;
+        PixelArtImage image{0, 0};
+    };
+
+    struct Throughput {
+        int images = 0;
+        double pixels = 0.0;
+        double milliseconds = 0.0;
+    };
+
+    void printUsage(const char *program) {
+        std::cout << "Usage: " << program << " [options]\n"
+                  << "  --golden <dir>       golden files (default assets/golden)\n"
+                  << "  --corpus <dir>       PNG corpus (default assets/images)\n"
+                  << "  --algorithm <name>   only run detect, banding or pillow\n"
+                  << "  --no-generated       skip the generated corpus\n"
+                  << "  --update             rewrite the golden files from this run\n"
+                  << "  --threads <n>        worker threads (default: all cores); results do not depend on it\n"
+                  << "  --csv <file>         write per-run timings as CSV\n"
+                  << "  --search <runs>      instead of the golden comparison, compare pillow-shading annealing with\n"
+                  << "                       best-of-N random restarts at equal CPU time, <runs> times per image\n"
+                  << "                       (not reproducible: annealing depends on how much fits in the budget)\n"
+                  << "  --search-budget <ms> CPU time of one annealing run in --search (default 50)\n"
+                  << "  -h, --help           show this message\n";
+    }
+
+    std::optional<Options> parseArguments(int argc, char **argv) {
+        Options options;
+
+        for (int i = 1; i < argc; ++i) {
+            std::string arg = argv[i];
+            auto nextValue = [&]() -> std::optional<std::string> {
+                if (i + 1 >= argc) {
+                    std::cerr << "Missing value for " << arg << std::endl;
+                    return std::nullopt;
+                }
+                return std::string(argv[++i]);
+            };
+
+            if (arg == "-h" || arg == "--help") {
+                return std::nullopt;
+            } else if (arg == "--golden") {
+                auto value = nextValue();
+                if (!value) return std::nullopt;
+                options.goldenDirectory = *value;
+            } else if (arg == "--corpus") {
+                auto value = nextValue();
+                if (!value) return std::nullopt;
+                options.corpusDirectory = *value;
+            } else if (arg == "--algorithm") {
+                auto value = nextValue();
+                if (!value) return std::nullopt;
+                if (std::ranges::find(ALGORITHMS, *value) == ALGORITHMS.end()) {
+                    std::cerr << "Unknown algorithm: " << *value << std::endl;
+                    return std::nullopt;
+                }
+                options.algorithms = {*value};
+            } else if (arg == "--no-generated") {
+                options.generated = false;
+            } else if (arg == "--update") {
+                options.update = true;
+            } else if (arg == "--threads") {
+                auto value = nextValue();
+                if (!value) return std::nullopt;
+                if (std::sscanf(value->c_str(), "%d", &options.threads) != 1 || options.threads < 0) {
+                    std::cerr << "Invalid thread count: " << *value << std::endl;
+                    return std::nullopt;
+                }
+            } else if (arg == "--search") {
+                auto value = nextValue();
+                if (!value) return std::nullopt;
+                if (std::sscanf(value->c_str(), "%d", &options.searchRuns) != 1 || options.searchRuns < 1) {
+                    std::cerr << "Invalid run count: " << *value << std::endl;
+                    return std::nullopt;
+                }
+            } else if (arg == "--search-budget") {
+                auto value = nextValue();
+                if (!value) return std::nullopt;
+                if (std::sscanf(value->c_str(), "%d", &options.searchBudgetMs) != 1 || options.searchBudgetMs < 1) {
+                    std::cerr << "Invalid budget: " << *value << std::endl;
+                    return std::nullopt;
+                }
+            } else if (arg == "--csv") {
+                auto value = nextValue();
+                if (!value) return std::nullopt;
+                options.csvPath = *value;
+            } else {
+                std::cerr << "Unknown option: " << arg << std::endl;
+                return std::nullopt;
+            }
+        }
+        return options;
+    }
+
+    std::unique_ptr<Algorithm> createAlgorithm(const std::string &name, PixelArtImage &image) {
+        if (name == "detect") return std::make_unique<BandingDetection>(image);
+        if (name == "banding") return std::make_unique<GeneralBandingCorrection>(image);
+        if (name == "pillow") return std::make_unique<PillowShadingCorrection>(image);
+        return nullptr;
+    }
+
+    /**
+     * Procedural sprites that are prone to banding: shaded spheres, stepped gradients and noisy blobs.
+     * Only raw mt19937 output is used, so the corpus is identical on every standard library.
+     */
+    std::vector<CorpusImage> generateCorpus() {
+        std::vector<CorpusImage> corpus;
+        std::mt19937 random(20250430);
+        const Color white(255, 255, 255);
+        const std::vector<Color> ramp = {
+            {40, 24, 60}, {84, 40, 96}, {140, 64, 120}, {200, 100, 140}, {240, 160, 170}, {252, 220, 210}
+        };
+
+        // Spheres lit from the top left, shaded in concentric steps
+        for (int size: {16, 32, 64}) {
+            CorpusImage sprite{"generated_sphere_" + std::to_string(size) + ".png", PixelArtImage(size, size)};
+            sprite.image.fill(white);
+            const float radius = size * 0.45f;
+            const float center = size * 0.5f;
+            const float lightX = size * 0.35f, lightY = size * 0.3f;
+            for (int y = 0; y < size; ++y)
+                for (int x = 0; x < size; ++x) {
+                    const float dx = x + 0.5f - center, dy = y + 0.5f - center;
+                    if (dx * dx + dy * dy > radius * radius) continue;
+                    const float lx = x + 0.5f - lightX, ly = y + 0.5f - lightY;
+                    const float light = 1.0f - std::min(1.0f, std::sqrt(lx * lx + ly * ly) / (radius * 1.6f));
+                    const auto step = std::min(static_cast<size_t>(light * ramp.size()), ramp.size() - 1);
+                    sprite.image.setPixel({x, y}, ramp[step]);
+                }
+            corpus.push_back(std::move(sprite));
+        }
+
+        // Horizontal gradients in equal steps: every step boundary is a banding candidate
+        for (int steps: {4, 6}) {
+            const int width = 48, height = 24;
+            CorpusImage sprite{"generated_gradient_" + std::to_string(steps) + ".png", PixelArtImage(width, height)};
+            sprite.image.fill(white);
+            for (int y = 2; y < height - 2; ++y)
+                for (int x = 2; x < width - 2; ++x)
+                    sprite.image.setPixel({x, y}, ramp[(x - 2) * steps / (width - 4) % ramp.size()]);
+            corpus.push_back(std::move(sprite));
+        }
+
+        // Random blobs: rectangles of random ramp colors on white
+        for (int k = 0; k < 3; ++k) {
+            const int width = 24 + static_cast<int>(random() % 40);
+            const int height = 24 + static_cast<int>(random() % 40);
+            CorpusImage sprite{"generated_blobs_" + std::to_string(k) + ".png", PixelArtImage(width, height)};
+            sprite.image.fill(white);
+            for (int r = 0; r < 12; ++r) {
+                const int x0 = static_cast<int>(random() % width), y0 = static_cast<int>(random() % height);
+                const int w = 2 + static_cast<int>(random() % 10), h = 2 + static_cast<int>(random() % 10);
+                const Color color = ramp[random() % ramp.size()];
+                for (int y = y0; y < std::min(height, y0 + h); ++y)
+                    for (int x = x0; x < std::min(width, x0 + w); ++x)
+                        sprite.image.setPixel({x, y}, color);
+            }
+            corpus.push_back(std::move(sprite));
+        }
+
+        return corpus;
+    }
+
+    std::vector<CorpusImage> loadCorpus(const Options &options) {
+        std::vector<std::filesystem::path> paths;
+        std::error_code error;
+        for (const auto &entry: std::filesystem::directory_iterator(options.corpusDirectory, error))
+            if (entry.path().extension() == ".png") paths.push_back(entry.path());
+        std::ranges::sort(paths);
+
+        std::vector<CorpusImage> corpus;
+        for (const auto &path: paths) {
+            CorpusImage item{path.filename().string(), PixelArtImage(0, 0)};
+            if (item.image.loadFromFile(path.string())) corpus.push_back(std::move(item));
+        }
+
+        if (options.generated) {
+            auto generated = generateCorpus();
+            std::ranges::move(generated, std::back_inserter(corpus));
+        }
+        return corpus;
+    }
+
+    // Golden banding errors, keyed by "<algorithm>/<image>"
+    std::map<std::string, int> readManifest(const std::filesystem::path &path) {
+        std::map<std::string, int> manifest;
+        std::ifstream in(path);
+        std::string key;
+        int error = 0;
+        while (in >> key >> error) manifest[key] = error;
+        return manifest;
+    }
+
+    bool writeManifest(const std::filesystem::path &path, const std::map<std::string, int> &manifest) {
+        const auto temporary = path.string() + ".tmp";
+        {
+            std::ofstream out(temporary);
+            for (const auto &[key, error]: manifest) out << key << ' ' << error << '\n';
+            if (!out) return false;
+        }
+        std::error_code error;
+        std::filesystem::rename(temporary, path, error);
+        return !error;
+    }
+
+    std::string hexColor(const Color &color) {
+        char text[8];
+        std::snprintf(text, sizeof(text), "#%02x%02x%02x", color.r, color.g, color.b);
+        return text;
+    }
+
+    /**
+     * Compares a result with its golden image.
+     * @param details receives the differences
+     * @return true if every pixel matches
+     */
+    bool comparePixels(const PixelArtImage &golden, const PixelArtImage &result, std::ostream &details) {
+        if (golden.getWidth() != result.getWidth() || golden.getHeight() != result.getHeight()) {
+            details << "    size " << result.getWidth() << "x" << result.getHeight() << ", golden "
+                    << golden.getWidth() << "x" << golden.getHeight() << '\n';
+            return false;
+        }
+
+        int differing = 0;
+        int minX = result.getWidth(), minY = result.getHeight(), maxX = -1, maxY = -1;
+        std::vector<std::string> examples;
+        for (int y = 0; y < result.getHeight(); ++y)
+            for (int x = 0; x < result.getWidth(); ++x) {
+                const Color expected = golden.getPixel({x, y}).color;
+                const Color actual = result.getPixel({x, y}).color;
+                if (expected == actual) continue;
+
+                ++differing;
+                minX = std::min(minX, x);
+                minY = std::min(minY, y);
+                maxX = std::max(maxX, x);
+                maxY = std::max(maxY, y);
+                if (examples.size() < MAX_REPORTED_PIXELS)
+                    examples.push_back("(" + std::to_string(x) + "," + std::to_string(y) + ") expected " +
+                                       hexColor(expected) + " got " + hexColor(actual));
+            }
+
+        if (differing == 0) return true;
+        details << "    " << differing << " pixels differ in [" << minX << "," << minY << "]-[" << maxX << ","
+                << maxY << "]\n";
+        for (const auto &example: examples) details << "      " << example << '\n';
+        return false;
+    }
+
+    /**
+     * Compares pillow-shading annealing with best-of-N random restarts at equal CPU time. Every image is
+     * corrected runs times by annealing; after each annealing run, restart runs (each the best of its trials)
+     * are repeated until they have used at least as much process CPU time, and the best of them is scored.
+     * One algorithm per mode serves all runs of an image, so every run draws new seeds.
+     * @return 0 if annealing reaches a strictly lower total banding error, 1 otherwise
+     */
+    int compareSearch(const std::vector<CorpusImage> &corpus, int runs, int budgetMs) {
+        struct Totals {
+            long error = 0;
+            double cpuSeconds = 0.0;
+            long restartRuns = 0;
+        };
+        Totals restartTotals, annealingTotals;
+
+        // Process CPU time: the trials and chains of a run are spread over all threads
+        auto runOnce = [](PillowShadingCorrection &pillow, PixelArtImage &image, double &cpuSeconds) {
+            const std::clock_t start = std::clock();
+            pillow.reset();
+            pillow.run();
+            cpuSeconds += static_cast<double>(std::clock() - start) / CLOCKS_PER_SEC;
+            return BandingDetection::detect(image).error;
+        };
+
+        std::cout << std::left << std::setw(30) << "image" << std::right << std::setw(16) << "annealing error"
+                << std::setw(10) << "CPU ms" << std::setw(16) << "restarts error" << std::setw(10) << "CPU ms"
+                << std::setw(10) << "runs" << std::endl;
+        for (const auto &item: corpus) {
+            PixelArtImage annealingImage = item.image, restartImage = item.image;
+            PillowShadingCorrection annealing(annealingImage), restarts(restartImage);
+            annealing.setSearchMode(PillowShadingCorrection::SearchMode::Annealing);
+            annealing.setSearchBudget(budgetMs);
+
+            Totals annealingImageTotals, restartImageTotals;
+            for (int run = 0; run < runs; ++run) {
+                annealingImageTotals.error += runOnce(annealing, annealingImage, annealingImageTotals.cpuSeconds);
+
+                int best = std::numeric_limits<int>::max();
+                const double target = annealingImageTotals.cpuSeconds;
+                while (restartImageTotals.cpuSeconds < target) {
+                    best = std::min(best, runOnce(restarts, restartImage, restartImageTotals.cpuSeconds));
+                    ++restartImageTotals.restartRuns;
+                }
+                if (best != std::numeric_limits<int>::max()) restartImageTotals.error += best;
+            }
+
+            std::cout << std::left << std::setw(30) << item.name << std::right << std::fixed << std::setprecision(2)
+                    << std::setw(16) << static_cast<double>(annealingImageTotals.error) / runs << std::setw(10)
+                    << annealingImageTotals.cpuSeconds * 1000.0 / runs << std::setw(16)
+                    << static_cast<double>(restartImageTotals.error) / runs << std::setw(10)
+                    << restartImageTotals.cpuSeconds * 1000.0 / runs << std::setw(10)
+                    << static_cast<double>(restartImageTotals.restartRuns) / runs << std::endl;
+            annealingTotals.error += annealingImageTotals.error;
+            annealingTotals.cpuSeconds += annealingImageTotals.cpuSeconds;
+            restartTotals.error += restartImageTotals.error;
+            restartTotals.cpuSeconds += restartImageTotals.cpuSeconds;
+        }
+
+        std::cout << std::endl << "Total over " << runs << " run(s) per image, " << budgetMs
+                << " CPU ms annealing budget" << std::endl << std::setprecision(3)
+                << "  annealing  banding error " << annealingTotals.error << " in " << annealingTotals.cpuSeconds
+                << " CPU s" << std::endl
+                << "  restarts   banding error " << restartTotals.error << " in " << restartTotals.cpuSeconds
+                << " CPU s" << std::endl;
+
+        const bool better = annealingTotals.error < restartTotals.error;
+        std::cout << std::endl << (better ? "Annealing beats" : "Annealing does not beat")
+                << " best-of-N restarts at equal CPU time" << std::endl;
+        return better ? 0 : 1;
+    }
+}
+
+int main(int argc, char **argv) {
+    auto options = parseArguments(argc, argv);
+    if (!options) {
+        printUsage(argv[0]);
+        return 2;
+    }
+
+    // Trials are seeded up front, so results do not depend on the thread count
+    TaskScheduler::setGlobalThreadCount(options->threads);
+
+    const auto corpus = loadCorpus(*options);
+    if (corpus.empty()) {
+        std::cerr << "The corpus is empty" << std::endl;
+        return 2;
+    }
+
+    if (options->searchRuns > 0) return compareSearch(corpus, options->searchRuns, options->searchBudgetMs);
+
+    const std::filesystem::path goldenDirectory = options->goldenDirectory;
+    const auto manifestPath = goldenDirectory / "manifest.txt";
+    auto manifest = readManifest(manifestPath);
+
+    std::ofstream csv;
+    if (!options->csvPath.empty()) {
+        csv.open(options->csvPath);
+        csv << "algorithm,image,width,height,milliseconds,banding_error\n";
+    }
+
+    int failures = 0;
+    std::map<std::string, Throughput> throughput;
+
+    for (const auto &name: options->algorithms) {
+        for (const auto &item: corpus) {
+            const std::string key = name + "/" + item.name;
+
+            // A fresh algorithm per run starts from its fixed seed
+            PixelArtImage result = item.image;
+            auto algorithm = createAlgorithm(name, result);
+            const auto start = std::chrono::steady_clock::now();
+            algorithm->reset();
+            algorithm->run();
+            const double milliseconds = std::chrono::duration<double, std::milli>(
+                std::chrono::steady_clock::now() - start).count();
+
+            const int bandingError = BandingDetection::detect(result).error;
+
+            auto &stats = throughput[name];
+            stats.images++;
+            stats.pixels += static_cast<double>(result.getWidth()) * result.getHeight();
+            stats.milliseconds += milliseconds;
+            if (csv.is_open())
+                csv << name << ',' << item.name << ',' << result.getWidth() << ',' << result.getHeight() << ','
+                        << milliseconds << ',' << bandingError << '\n';
+
+            // Debug overlays are not part of the output
+            result.clearDebugLines();
+            result.clearDebugPixels();
+            const auto goldenImage = goldenDirectory / name / item.name;
+
+            if (options->update) {
+                std::error_code error;
+                std::filesystem::create_directories(goldenImage.parent_path(), error);
+                if (!result.saveToFile(goldenImage.string())) {
+                    std::cerr << "Failed to write " << goldenImage.string() << std::endl;
+                    return 1;
+                }
+                manifest[key] = bandingError;
+                continue;
+            }
+
+            const auto expectedError = manifest.find(key);
+            PixelArtImage golden(0, 0);
+            if (expectedError == manifest.end() || !std::filesystem::exists(goldenImage) ||
+                !golden.loadFromFile(goldenImage.string())) {
+                std::cout << "MISSING " << key << " (run with --update to create it)" << std::endl;
+                ++failures;
+                continue;
+            }
+
+            std::ostringstream details;
+            bool passed = comparePixels(golden, result, details);
+            if (bandingError != expectedError->second) {
+                details << "    banding error " << bandingError << ", golden " << expectedError->second << " ("
+                        << std::showpos << bandingError - expectedError->second << std::noshowpos << ")\n";
+                passed = false;
+            }
+            std::cout << (passed ? "ok      " : "FAILED  ") << key << std::endl << details.str();
+            if (!passed) ++failures;
+        }
+    }
+
+    if (options->update) {
+        std::error_code error;
+        std::filesystem::create_directories(goldenDirectory, error);
+        if (!writeManifest(manifestPath, manifest)) {
+            std::cerr << "Failed to write " << manifestPath.string() << std::endl;
+            return 1;
+        }
+        std::cout << "Updated " << options->algorithms.size() * corpus.size() << " golden results in "
+                << goldenDirectory.string() << std::endl;
+    }
+
+    std::cout << std::endl << "Throughput (" << TaskScheduler::global().getWorkerCount() + 1 << " threads)" << std::endl;
+    for (const auto &[name, stats]: throughput) {
+        const double seconds = stats.milliseconds / 1000.0;
+        std::cout << "  " << std::left << std::setw(10) << name << std::right << std::fixed << std::setprecision(2)
+                << std::setw(10) << stats.milliseconds << " ms  " << std::setw(10)
+                << (seconds > 0 ? stats.images / seconds : 0.0) << " images/s  " << std::setw(10)
+                << (seconds > 0 ? stats.pixels / seconds / 1e6 : 0.0) << " Mpx/s" << std::endl;
+    }
+
+    if (failures > 0) {
+        std::cout << std::endl << failures << " golden comparison(s) failed" << std::endl;
+        return 1;
+    }
+    return 0;
+}
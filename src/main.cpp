@@ -10,6 +10,9 @@
 
 #include "../include/PixelArtImage.h"
 #include "../include/Algorithm.h"
+#include "../include/AlgorithmJob.h"
+#include "../include/MemoryStats.h"
+#include "../include/Profiler.h"
 #include "../include/PillowShadingCorrection.h"
 #include "../include/BandingDetection.h"
 #include "../include/GeneralBandingCorrection.h"
@@ -18,6 +21,15 @@ static void glfw_error_callback(int error, const char *description) {
     fprintf(stderr, "Glfw Error %d: %s\n", error, description);
 }
 
+// Set by any window input; the main loop keeps rendering for a few frames afterwards
+static bool inputReceived = true;
+
+static void markInputReceived(GLFWwindow *, int, int, int, int) { inputReceived = true; }
+static void markCursorInputReceived(GLFWwindow *, double, double) { inputReceived = true; }
+static void markButtonInputReceived(GLFWwindow *, int, int, int) { inputReceived = true; }
+static void markCharInputReceived(GLFWwindow *, unsigned int) { inputReceived = true; }
+static void markWindowInputReceived(GLFWwindow *, int) { inputReceived = true; }
+
 void applyTheme() {
     ImGui::StyleColorsDark();
     ImGuiStyle &style = ImGui::GetStyle();
@@ -100,20 +112,55 @@ std::vector<std::string> getImageFilesFromDirectory(const std::string &path) {
 }
 
 
-GLuint createTextureFromCanvas(const PixelArtImage &canvas) {
-    GLuint textureID;
-    glGenTextures(1, &textureID);
-    glBindTexture(GL_TEXTURE_2D, textureID);
-
+/**
+ * GPU copy of the canvas, tagged with the canvas revision it was uploaded from.
+ */
+struct CanvasTexture {
+    GLuint id = 0;
+    int width = 0;
+    int height = 0;
+    uint64_t revision = 0;
+};
+
+/**
+ * Uploads the canvas into the texture, unless the texture already holds its current revision.
+ * The texture object is reused; it is only reallocated when the canvas size changes.
+ */
+void updateCanvasTexture(CanvasTexture &texture, const PixelArtImage &canvas) {
+    const bool sameSize = texture.width == canvas.getWidth() && texture.height == canvas.getHeight();
+    if (texture.id != 0 && sameSize && texture.revision == canvas.getRevision()) return;
+
+    PF_PROFILE_SCOPE("textureUpload");
     std::vector<unsigned char> rgbaData = canvas.getRGBAData();
 
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, canvas.getWidth(), canvas.getHeight(), 0,
-                 GL_RGBA, GL_UNSIGNED_BYTE, rgbaData.data());
+    if (texture.id == 0) {
+        glGenTextures(1, &texture.id);
+        glBindTexture(GL_TEXTURE_2D, texture.id);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        texture.width = 0;
+        texture.height = 0;
+    } else {
+        glBindTexture(GL_TEXTURE_2D, texture.id);
+    }
 
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    if (texture.width == canvas.getWidth() && texture.height == canvas.getHeight()) {
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, canvas.getWidth(), canvas.getHeight(),
+                        GL_RGBA, GL_UNSIGNED_BYTE, rgbaData.data());
+    } else {
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, canvas.getWidth(), canvas.getHeight(), 0,
+                     GL_RGBA, GL_UNSIGNED_BYTE, rgbaData.data());
+    }
+
+    texture.width = canvas.getWidth();
+    texture.height = canvas.getHeight();
+    texture.revision = canvas.getRevision();
+}
 
-    return textureID;
+void deleteCanvasTexture(CanvasTexture &texture) {
+    if (texture.id != 0)
+        glDeleteTextures(1, &texture.id);
+    texture = CanvasTexture{};
 }
 
 // HELPER METHODS FOR MAIN
@@ -144,6 +191,15 @@ void initImGui(GLFWwindow *window, const char *glsl_version, ImFont *&defaultFon
     if (ImFont *font = loadFont())
         io.FontDefault = font;
 
+    // Installed before the ImGui backend, which chains to them from its own callbacks
+    glfwSetKeyCallback(window, markInputReceived);
+    glfwSetCursorPosCallback(window, markCursorInputReceived);
+    glfwSetMouseButtonCallback(window, markButtonInputReceived);
+    glfwSetScrollCallback(window, markCursorInputReceived);
+    glfwSetCharCallback(window, markCharInputReceived);
+    glfwSetWindowFocusCallback(window, markWindowInputReceived);
+    glfwSetCursorEnterCallback(window, markWindowInputReceived);
+
     ImGui_ImplGlfw_InitForOpenGL(window, true);
     ImGui_ImplOpenGL3_Init(glsl_version);
 }
@@ -161,6 +217,11 @@ std::string getExportPath() {
     return std::filesystem::absolute(filePath).string();
 }
 
+std::string getTraceExportPath() {
+    std::filesystem::path exportPath = std::filesystem::path(getExportPath()).parent_path() / "profile_trace.json";
+    return exportPath.string();
+}
+
 std::string getUniqueFilePath(const std::string& basePath) {
     namespace fs = std::filesystem;
 
@@ -183,18 +244,25 @@ std::string getUniqueFilePath(const std::string& basePath) {
 
 
 void renderLeftMenu(int &mode, const std::vector<std::string> &imageFiles,
-                    std::string &selectedImage, GLuint &canvasTexture, PixelArtImage &canvas,
+                    std::string &selectedImage, CanvasTexture &canvasTexture, PixelArtImage &canvas,
                     std::vector<Pixel> &drawnPath,
                     const std::vector<std::unique_ptr<Algorithm> > &algorithms,
+                    std::unique_ptr<AlgorithmJob> &activeJob,
+                    bool &showProfiler,
+                    bool &showMemory,
                     ImFont *headerFont) {
     ImGui::SetNextWindowSize(ImVec2(260, 540), ImGuiCond_Always);
     ImGui::SetNextWindowPos(ImVec2(0, 0), ImGuiCond_Always);
     ImGui::Begin("Menu", nullptr, ImGuiWindowFlags_NoResize | ImGuiWindowFlags_NoMove |
                                   ImGuiWindowFlags_NoTitleBar | ImGuiWindowFlags_AlwaysAutoResize);
 
+    // The canvas must not change under a running job: only its own Cancel button stays enabled
+    const bool jobRunning = activeJob != nullptr;
+
     if (headerFont) ImGui::PushFont(headerFont);
     ImGui::Text("Set-Up");
     if (headerFont) ImGui::PopFont();
+    ImGui::BeginDisabled(jobRunning);
     ImGui::Spacing();
     ImGui::Text("Mode");
     const char *modes[] = {"Draw Point", "Select Segments", "Draw Freely"};
@@ -223,10 +291,7 @@ void renderLeftMenu(int &mode, const std::vector<std::string> &imageFiles,
                         if (algo) algo->reset();
                     }
 
-                    if (canvasTexture != 0) {
-                        glDeleteTextures(1, &canvasTexture);
-                    }
-                    canvasTexture = createTextureFromCanvas(canvas);
+                    updateCanvasTexture(canvasTexture, canvas);
                 } else {
                     std::cerr << "Failed to auto-load image: " << imagePath << std::endl;
                 }
@@ -248,6 +313,7 @@ void renderLeftMenu(int &mode, const std::vector<std::string> &imageFiles,
     } else {
         ImGui::Text("No images available.");
     }
+    ImGui::EndDisabled();
 
     ImGui::Spacing();
     ImGui::Separator();
@@ -261,30 +327,46 @@ void renderLeftMenu(int &mode, const std::vector<std::string> &imageFiles,
 
         ImGui::Text("%s:", algo->name().c_str());
 
+        const bool isRunning = jobRunning && &activeJob->getAlgorithm() == algo.get();
+
         float indentSpacing = 6;
         ImGui::Indent(indentSpacing);
         ImGui::PushStyleVar(ImGuiStyleVar_FramePadding, ImVec2(0, 0));
         ImVec2 buttonSize(40, 20);
-        if (ImGui::Button("Run", buttonSize)) {
-            algo->reset();
-            algo->run();
-        }
-        ImGui::SameLine();
-        ImGui::PushStyleColor(ImGuiCol_Button, ImVec4(0.5f, 0.5f, 0.5f, 1.0f));           // Normal
-        ImGui::PushStyleColor(ImGuiCol_ButtonHovered, ImVec4(0.6f, 0.6f, 0.6f, 1.0f));    // Hovered
-        ImGui::PushStyleColor(ImGuiCol_ButtonActive, ImVec4(0.4f, 0.4f, 0.4f, 1.0f));     // Pressed
+        if (isRunning) {
+            ImGui::ProgressBar(activeJob->getProgress(), ImVec2(-buttonSize.x - 8, buttonSize.y));
+            ImGui::SameLine();
+            if (ImGui::Button("Cancel", ImVec2(buttonSize.x + 8, buttonSize.y))) {
+                activeJob->cancel();
+            }
+        } else {
+            ImGui::BeginDisabled(jobRunning);
+            if (ImGui::Button("Run", buttonSize)) {
+                // Wake the idle main loop as soon as the result is ready
+                activeJob = std::make_unique<AlgorithmJob>(*algo, canvas, [] { glfwPostEmptyEvent(); });
+            }
+            ImGui::SameLine();
+            ImGui::PushStyleColor(ImGuiCol_Button, ImVec4(0.5f, 0.5f, 0.5f, 1.0f));           // Normal
+            ImGui::PushStyleColor(ImGuiCol_ButtonHovered, ImVec4(0.6f, 0.6f, 0.6f, 1.0f));    // Hovered
+            ImGui::PushStyleColor(ImGuiCol_ButtonActive, ImVec4(0.4f, 0.4f, 0.4f, 1.0f));     // Pressed
 
-        if (ImGui::Button("Reset", buttonSize)) {
-            algo->reset();
+            if (ImGui::Button("Reset", buttonSize)) {
+                algo->reset();
+            }
+            ImGui::PopStyleColor(3);
+            ImGui::EndDisabled();
         }
-        ImGui::PopStyleColor(3);
         ImGui::PopStyleVar();
         ImGui::Unindent(indentSpacing);
 
         ImGui::Spacing();
 
         if (ImGui::TreeNode("User Options")) {
-            algo->renderUI();
+            // The running algorithm is bound to the job's snapshot, which its UI must not read
+            if (isRunning)
+                ImGui::Text("Running...");
+            else
+                algo->renderUI();
             ImGui::TreePop();
         }
 
@@ -296,9 +378,7 @@ void renderLeftMenu(int &mode, const std::vector<std::string> &imageFiles,
 
 
         // Refresh texture after debug drawing, if needed
-        if (canvasTexture != 0)
-            glDeleteTextures(1, &canvasTexture);
-        canvasTexture = createTextureFromCanvas(canvas);
+        updateCanvasTexture(canvasTexture, canvas);
 
         ImGui::PopID();
         ImGui::Spacing();
@@ -312,12 +392,14 @@ void renderLeftMenu(int &mode, const std::vector<std::string> &imageFiles,
     static double saveMessageTime = -1.0f;
     static bool saveSuccess = false;
 
+    ImGui::BeginDisabled(jobRunning);
     if (ImGui::Button("Save to \"exports\"")) {
         std::string path = getExportPath();
         std::string uniquePath = getUniqueFilePath(path);
         saveSuccess = canvas.saveToFile(uniquePath);
         saveMessageTime = ImGui::GetTime();
     }
+    ImGui::EndDisabled();
 
     if (saveMessageTime >= 0.0f && ImGui::GetTime() - saveMessageTime < 2.0f) {
         ImVec4 color = saveSuccess ? ImVec4(0.2f, 1.0f, 0.2f, 1.0f) : ImVec4(1.0f, 0.2f, 0.2f, 1.0f);
@@ -325,13 +407,35 @@ void renderLeftMenu(int &mode, const std::vector<std::string> &imageFiles,
         ImGui::TextColored(color, "%s", message);
     }
 
+    ImGui::Checkbox("Show Profiler", &showProfiler);
+    ImGui::Checkbox("Show Memory", &showMemory);
+
     ImGui::End();
 }
 
-void renderCanvas(int mode, const std::string &selectedImage, GLuint &canvasTexture, PixelArtImage &canvas,
+std::pair<Pos, Pos> segmentBounds(const std::vector<Pixel> &segment) {
+    Pos minPos = segment.front().pos;
+    Pos maxPos = segment.front().pos;
+    for (const auto &pixel: segment) {
+        minPos = glm::min(minPos, pixel.pos);
+        maxPos = glm::max(maxPos, pixel.pos);
+    }
+    return {minPos, maxPos};
+}
+
+// Outlines a segment's bounding box in green, on the same pixel edges PixelArtImage::drawRectangle uses
+void addSegmentRect(ImDrawList *drawList, ImVec2 canvasPos, float zoom, const std::pair<Pos, Pos> &bounds) {
+    const auto &[minPos, maxPos] = bounds;
+    ImVec2 topLeft(canvasPos.x + static_cast<float>(minPos.x) * zoom, canvasPos.y + static_cast<float>(minPos.y) * zoom);
+    ImVec2 bottomRight(canvasPos.x + static_cast<float>(maxPos.x + 1) * zoom,
+                       canvasPos.y + static_cast<float>(maxPos.y + 1) * zoom);
+    drawList->AddRect(topLeft, bottomRight, IM_COL32(0, 255, 0, 255), 0.0f, 0, 1.5f);
+}
+
+void renderCanvas(int mode, const std::string &selectedImage, CanvasTexture &canvasTexture, PixelArtImage &canvas,
                   std::vector<Pixel> &drawnPath, bool &mousePressed,
                   const std::vector<std::unique_ptr<Algorithm> > &algorithms,
-                  float& zoom) {
+                  float& zoom, bool interactive) {
     ImGui::SetNextWindowPos(ImVec2(260, 0), ImGuiCond_Always);
     ImGui::SetNextWindowSize(ImVec2(480, 470), ImGuiCond_Always);
     ImGui::Begin("Pixel Artwork", nullptr,
@@ -343,18 +447,15 @@ void renderCanvas(int mode, const std::string &selectedImage, GLuint &canvasText
         lastLoadedImage = selectedImage;
         std::string path = "../assets/images/" + selectedImage;
         if (canvas.loadFromFile(path)) {
-            if (canvasTexture != 0)
-                glDeleteTextures(1, &canvasTexture);
-            canvasTexture = createTextureFromCanvas(canvas);
+            updateCanvasTexture(canvasTexture, canvas);
 
             for (auto &algo: algorithms) {
                 if (algo) algo->reset();
             }
 
-            auto detection = std::make_unique<BandingDetection>(canvas);
-            auto [err, affected, _] = detection->bandingDetection();
-            canvas.setAffectedSegments(affected);
-            canvas.setError(err);
+            auto report = BandingDetection::detect(canvas);
+            canvas.setAffectedSegments(report.segments);
+            canvas.setError(report.error);
             canvas.clearDebugLines();
         } else {
             std::cerr << "Failed to load image: " << path << std::endl;
@@ -404,12 +505,11 @@ void renderCanvas(int mode, const std::string &selectedImage, GLuint &canvasText
             }
         }
 
-        if (ImGui::IsMouseClicked(0)) mousePressed = true;
+        if (ImGui::IsMouseClicked(0) && interactive) mousePressed = true;
         if (ImGui::IsMouseReleased(0)) mousePressed = false;
 
-        if (canvasTexture != 0) glDeleteTextures(1, &canvasTexture);
-        canvasTexture = createTextureFromCanvas(canvas);
-        ImGui::Image(static_cast<ImTextureID>(static_cast<intptr_t>(canvasTexture)),
+        updateCanvasTexture(canvasTexture, canvas);
+        ImGui::Image(static_cast<ImTextureID>(static_cast<intptr_t>(canvasTexture.id)),
                              ImVec2(static_cast<float>(canvas.getWidth()) * zoom,
                                     static_cast<float>(canvas.getHeight()) * zoom));
 
@@ -426,17 +526,17 @@ void renderCanvas(int mode, const std::string &selectedImage, GLuint &canvasText
 
     } else {
         if (!selectedImage.empty()) {
-            if (canvasTexture != 0) {
+            if (canvasTexture.id != 0) {
                 ImVec2 canvas_pos = ImGui::GetCursorScreenPos(); // Get position before rendering image
 
                 // Zoomed canvas image
-                ImGui::Image(static_cast<ImTextureID>(static_cast<intptr_t>(canvasTexture)),
+                updateCanvasTexture(canvasTexture, canvas);
+                ImGui::Image(static_cast<ImTextureID>(static_cast<intptr_t>(canvasTexture.id)),
                              ImVec2(static_cast<float>(canvas.getWidth()) * zoom,
                                     static_cast<float>(canvas.getHeight()) * zoom));
 
                 // Highlight clusters on hover (in red color)
                 ImDrawList* draw_list = ImGui::GetWindowDrawList();
-                canvas.clearDebugLinesWithColor({0, 255, 0});
                 const float lineOffset = 0.5f * zoom;  // Adjust this offset as needed for line rendering
 
                 // Hover effect - Check if the mouse is over a cluster
@@ -470,40 +570,34 @@ void renderCanvas(int mode, const std::string &selectedImage, GLuint &canvasText
                 //     }
                 // }
 
-                auto detection = std::make_unique<BandingDetection>(canvas);
-                auto [err, affected, _] = detection->bandingDetection();
-                canvas.setAffectedSegments(affected);
-                canvas.setError(err);
-
-                for (auto& segment : canvas.getAffectedSegments()) {
-                    bool drawn = false;
-                    if (drawn == false) {
-                        for (auto& pixel : segment) {
-                            ImVec2 pixelPos = ImVec2(pixel.pos.x, pixel.pos.y);
-                            float dist = sqrtf(powf(relativeMousePos.x - pixelPos.x, 2.0f) + powf(relativeMousePos.y - pixelPos.y, 2.0f));
-
-                            if (dist < 0.7f) {
-                                // Left-click to select or deselect this cluster
-                                if (ImGui::IsMouseClicked(0)) {
-                                    if (canvas.getSelectedSegment() == segment)
-                                        canvas.clearSelectedSegment(); // Deselect
-                                    else {
-                                        canvas.setSelectedSegment(segment); // Select
-                                    }
-                                }
-
-                                // Draw hovered cluster
-                                canvas.drawRectangle(segment, {0, 255, 0});
-                                drawn = true;
-                            }
-                        }
-                    }
+                // Detection only reruns when the pixels changed, or when a reset wiped its red overlay;
+                // a local correction that already updated the banding state marks its revision current
+                static uint64_t detectedRevision = 0;
+                if ((canvas.getRevision() != detectedRevision && canvas.getRevision() != canvas.getBandingRevision()) ||
+                    (canvas.getError() > 0 && canvas.getDebugLines().empty())) {
+                    auto report = BandingDetection::detect(canvas);
+                    BandingDetection::visualize(report, canvas);
+                    canvas.setAffectedSegments(report.segments);
+                    canvas.setError(report.error);
+                    detectedRevision = canvas.getRevision();
                 }
 
+                // Hit-test the pixel under the mouse against the segment-id grid
+                const Pos hoveredPixel(static_cast<int>(std::floor(relativeMousePos.x)),
+                                       static_cast<int>(std::floor(relativeMousePos.y)));
+                const int hoveredId = ImGui::IsWindowHovered() ? canvas.getAffectedSegmentAt(hoveredPixel) : -1;
+
+                if (hoveredId >= 0 && ImGui::IsMouseClicked(0) && interactive) {
+                    // Left-click to select or deselect this segment
+                    const auto &segment = canvas.getAffectedSegments()[hoveredId];
+                    if (canvas.getSelectedSegment() == segment)
+                        canvas.clearSelectedSegment(); // Deselect
+                    else
+                        canvas.setSelectedSegment(segment); // Select
+                }
 
-                if (canvas.getSelectedSegment().size() > 0) {
-                    canvas.drawRectangle(canvas.getSelectedSegment(), {0, 255, 0});
 
+                if (canvas.getSelectedSegment().size() > 0) {
                     for (const auto& p : canvas.getSelectedSegment()) {
                         ImVec2 p1 = ImVec2(canvas_pos.x + p.pos.x * zoom + lineOffset, canvas_pos.y + p.pos.y * zoom + lineOffset);
                         draw_list->AddCircle(p1, zoom/3.0f, IM_COL32(0, 255, 0, 255), 12);
@@ -519,6 +613,12 @@ void renderCanvas(int mode, const std::string &selectedImage, GLuint &canvasText
                     ImU32 imColor = IM_COL32(color.r, color.g, color.b, 255);
                     draw_list->AddLine(p1, p2, imColor, 1.5f);
                 }
+
+                // Draw hovered and selected segments from their cached bounds
+                if (hoveredId >= 0)
+                    addSegmentRect(draw_list, canvas_pos, zoom, canvas.getAffectedSegmentBounds(hoveredId));
+                if (!canvas.getSelectedSegment().empty())
+                    addSegmentRect(draw_list, canvas_pos, zoom, segmentBounds(canvas.getSelectedSegment()));
             }
         }
     }
@@ -539,6 +639,156 @@ void renderCanvas(int mode, const std::string &selectedImage, GLuint &canvasText
     ImGui::End(); // End the slider window
 }
 
+void renderZoneTable(const char *id, const std::vector<Profiler::ZoneStats> &zones) {
+    if (zones.empty()) {
+        ImGui::Text("No zones recorded.");
+        return;
+    }
+
+    if (ImGui::BeginTable(id, 3, ImGuiTableFlags_RowBg | ImGuiTableFlags_SizingStretchProp)) {
+        ImGui::TableSetupColumn("Zone");
+        ImGui::TableSetupColumn("ms");
+        ImGui::TableSetupColumn("Calls");
+        ImGui::TableHeadersRow();
+
+        for (const auto &zone: zones) {
+            ImGui::TableNextRow();
+            ImGui::TableNextColumn();
+            ImGui::Indent(10.0f * static_cast<float>(zone.depth) + 1.0f);
+            ImGui::Text("%s", zone.name.c_str());
+            ImGui::Unindent(10.0f * static_cast<float>(zone.depth) + 1.0f);
+            ImGui::TableNextColumn();
+            ImGui::Text("%.3f", zone.totalMs);
+            ImGui::TableNextColumn();
+            ImGui::Text("%d", zone.calls);
+        }
+        ImGui::EndTable();
+    }
+}
+
+void renderProfilerWindow(bool &open) {
+    if (!open) return;
+
+    ImGui::SetNextWindowSize(ImVec2(420, 360), ImGuiCond_FirstUseEver);
+    if (!ImGui::Begin("Profiler", &open)) {
+        ImGui::End();
+        return;
+    }
+
+    if (!Profiler::isEnabled()) {
+        ImGui::Text("Profiling zones were compiled out (PIXELFIXER_PROFILING is off).");
+        ImGui::End();
+        return;
+    }
+
+    static double exportMessageTime = -1.0;
+    static bool exportSuccess = false;
+
+    if (ImGui::Button("Export Chrome Trace")) {
+        exportSuccess = Profiler::exportChromeTrace(getUniqueFilePath(getTraceExportPath()));
+        exportMessageTime = ImGui::GetTime();
+    }
+    ImGui::SameLine();
+    if (ImGui::Button("Clear")) {
+        Profiler::clear();
+    }
+
+    if (exportMessageTime >= 0.0 && ImGui::GetTime() - exportMessageTime < 2.0) {
+        ImVec4 color = exportSuccess ? ImVec4(0.2f, 1.0f, 0.2f, 1.0f) : ImVec4(1.0f, 0.2f, 0.2f, 1.0f);
+        ImGui::TextColored(color, "%s", exportSuccess ? "Trace exported to \"exports\"." : "Failed to export trace.");
+    }
+
+    if (ImGui::CollapsingHeader("Last Frame", ImGuiTreeNodeFlags_DefaultOpen)) {
+        renderZoneTable("##FrameZones", Profiler::getFrameStats());
+    }
+    if (ImGui::CollapsingHeader("Last Run", ImGuiTreeNodeFlags_DefaultOpen)) {
+        renderZoneTable("##RunZones", Profiler::getRunStats());
+    }
+
+    ImGui::End();
+}
+
+void renderMemoryTable(const char *id, const MemoryBreakdown &breakdown) {
+    if (ImGui::BeginTable(id, 2, ImGuiTableFlags_RowBg | ImGuiTableFlags_SizingStretchProp)) {
+        ImGui::TableSetupColumn("Structure");
+        ImGui::TableSetupColumn("Size");
+        ImGui::TableHeadersRow();
+
+        for (const auto &item: breakdown) {
+            ImGui::TableNextRow();
+            ImGui::TableNextColumn();
+            ImGui::Text("%s", item.name.c_str());
+            ImGui::TableNextColumn();
+            ImGui::Text("%s", MemoryStats::formatBytes(item.bytes).c_str());
+        }
+        ImGui::EndTable();
+    }
+}
+
+void renderMemoryWindow(bool &open, const PixelArtImage &canvas,
+                        const std::vector<std::unique_ptr<Algorithm> > &algorithms, bool jobRunning) {
+    if (!open) return;
+
+    ImGui::SetNextWindowSize(ImVec2(380, 420), ImGuiCond_FirstUseEver);
+    if (!ImGui::Begin("Memory", &open)) {
+        ImGui::End();
+        return;
+    }
+
+    ImGui::Text("Resident: %s (peak %s)", MemoryStats::formatBytes(MemoryStats::residentBytes()).c_str(),
+                MemoryStats::formatBytes(MemoryStats::peakResidentBytes()).c_str());
+    ImGui::SameLine();
+    if (ImGui::Button("Clear")) {
+        MemoryStats::clear();
+    }
+
+    const MemoryBreakdown image = canvas.getMemoryUsage();
+    if (ImGui::CollapsingHeader("Image", ImGuiTreeNodeFlags_DefaultOpen)) {
+        ImGui::Text("Total: %s", MemoryStats::formatBytes(MemoryStats::total(image)).c_str());
+        renderMemoryTable("##ImageMemory", image);
+    }
+
+    if (ImGui::CollapsingHeader("Algorithm Scratch", ImGuiTreeNodeFlags_DefaultOpen)) {
+        // A running job owns its algorithm's scratch; it is only read between runs
+        if (jobRunning) {
+            ImGui::Text("Available once the running job finishes.");
+        } else {
+            for (const auto &algorithm: algorithms) {
+                const MemoryBreakdown scratch = algorithm->getMemoryUsage();
+                if (scratch.empty()) continue;
+                ImGui::Text("%s: %s", algorithm->name().c_str(),
+                            MemoryStats::formatBytes(MemoryStats::total(scratch)).c_str());
+                renderMemoryTable(algorithm->name().c_str(), scratch);
+            }
+        }
+    }
+
+    if (ImGui::CollapsingHeader("Stage Peaks", ImGuiTreeNodeFlags_DefaultOpen)) {
+        const auto stages = MemoryStats::getStageStats();
+        if (stages.empty()) {
+            ImGui::Text("No stages recorded.");
+        } else if (ImGui::BeginTable("##StagePeaks", 3, ImGuiTableFlags_RowBg | ImGuiTableFlags_SizingStretchProp)) {
+            ImGui::TableSetupColumn("Stage");
+            ImGui::TableSetupColumn("Peak");
+            ImGui::TableSetupColumn("Samples");
+            ImGui::TableHeadersRow();
+
+            for (const auto &stage: stages) {
+                ImGui::TableNextRow();
+                ImGui::TableNextColumn();
+                ImGui::Text("%s", stage.name.c_str());
+                ImGui::TableNextColumn();
+                ImGui::Text("%s", MemoryStats::formatBytes(stage.peakBytes).c_str());
+                ImGui::TableNextColumn();
+                ImGui::Text("%d", stage.samples);
+            }
+            ImGui::EndTable();
+        }
+    }
+
+    ImGui::End();
+}
+
 std::vector<std::unique_ptr<Algorithm> > loadAlgorithms(PixelArtImage &canvas) {
     std::vector<std::unique_ptr<Algorithm> > algos;
     algos.emplace_back(std::make_unique<PillowShadingCorrection>(canvas));
@@ -558,22 +808,56 @@ void runMainLoop(GLFWwindow *window) {
     std::string selectedImage = imageFiles.empty() ? "" : imageFiles[0];
 
     PixelArtImage canvas = PixelArtImage(32, 32);
-    GLuint canvasTexture = 0;
+    CanvasTexture canvasTexture;
     canvas.fill({255, 255, 255});
     int mode = 0;
     bool mousePressed = false;
     float zoom = 8.0f;
     std::vector<Pixel> drawnPath;
     auto algorithms = loadAlgorithms(canvas);
+    std::unique_ptr<AlgorithmJob> activeJob;
+    bool showProfiler = false;
+    bool showMemory = false;
+
+    // Seconds to sleep when idle; bounds the latency of time-based UI such as the save message
+    constexpr double idleWaitSeconds = 0.25;
+    // Frames rendered after the last input, so ImGui can settle hover and active states
+    constexpr int settleFrames = 3;
+    int framesToRender = settleFrames;
 
     while (!glfwWindowShouldClose(window)) {
-        glfwPollEvents();
+        // Render continuously only while a job reports progress or ImGui is settling after input
+        if (activeJob || framesToRender > 0)
+            glfwPollEvents();
+        else
+            glfwWaitEventsTimeout(idleWaitSeconds);
+
+        if (inputReceived) {
+            inputReceived = false;
+            framesToRender = settleFrames;
+        } else if (framesToRender > 0) {
+            --framesToRender;
+        }
+
+        Profiler::beginFrame();
+
+        // Swap a finished result into the displayed canvas between frames
+        if (activeJob && activeJob->isFinished()) {
+            activeJob->collect();
+            activeJob.reset();
+            framesToRender = settleFrames;
+        }
+
         ImGui_ImplOpenGL3_NewFrame();
         ImGui_ImplGlfw_NewFrame();
         ImGui::NewFrame();
 
-        renderCanvas(mode, selectedImage, canvasTexture, canvas, drawnPath, mousePressed, algorithms, zoom);
-        renderLeftMenu(mode, imageFiles, selectedImage, canvasTexture, canvas, drawnPath, algorithms, headerFont);
+        renderCanvas(mode, selectedImage, canvasTexture, canvas, drawnPath, mousePressed, algorithms, zoom,
+                     activeJob == nullptr);
+        renderLeftMenu(mode, imageFiles, selectedImage, canvasTexture, canvas, drawnPath, algorithms, activeJob,
+                       showProfiler, showMemory, headerFont);
+        renderProfilerWindow(showProfiler);
+        renderMemoryWindow(showMemory, canvas, algorithms, activeJob != nullptr);
 
         ImGui::Render();
         int display_w, display_h;
@@ -586,8 +870,10 @@ void runMainLoop(GLFWwindow *window) {
         glfwSwapBuffers(window);
     }
 
-    if (canvasTexture != 0)
-        glDeleteTextures(1, &canvasTexture);
+    // Cancel and join a still-running job before the canvas goes away
+    activeJob.reset();
+
+    deleteCanvasTexture(canvasTexture);
 }
 
 // --- Cleanup ---